@@ -0,0 +1,649 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <systemd/sd-bus.h>
+#include <systemd/sd-event.h>
+
+/*
+ * A stand-in for org.freedesktop.systemd1 which exposes a configurable
+ * number of synthetic units. It implements just enough of the manager
+ * and unit interfaces for servicemaster to run against it, plus a small
+ * control interface used by the benchmark to trigger signal storms,
+ * daemon reloads and unit churn.
+ */
+
+#define MOCK_DESTINATION "org.freedesktop.systemd1"
+#define MOCK_IFACE(x)    "org.freedesktop.systemd1." x
+#define MOCK_OPATH       "/org/freedesktop/systemd1"
+#define MOCK_UNIT_PREFIX "/org/freedesktop/systemd1/unit"
+#define MOCK_JOB_PREFIX  "/org/freedesktop/systemd1/job"
+#define MOCK_CONTROL     "org.servicemaster.Mock"
+
+struct unit {
+    char name[64];
+    char path[96];
+    char description[64];
+    const char *load;
+    const char *active;
+    const char *sub;
+    const char *file_state;
+    const char *type;
+    unsigned restarts;
+    bool alive;
+};
+
+static const char *mock_types[] = {
+    "service", "socket", "timer", "mount", "device",
+    "scope", "slice", "target", "path", "swap"
+};
+
+static struct unit *units = NULL;
+static unsigned n_units = 0;
+static unsigned n_alive = 0;
+static unsigned cap_units = 0;
+static unsigned next_job = 1;
+static sd_bus *bus = NULL;
+
+static void mock_unit_add(unsigned idx)
+{
+    struct unit *u;
+    const char *type = mock_types[idx % (sizeof(mock_types) / sizeof(*mock_types))];
+
+    if (n_units == cap_units) {
+        cap_units = cap_units ? cap_units * 2 : 1024;
+        units = realloc(units, cap_units * sizeof(*units));
+        if (!units) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    u = &units[n_units++];
+    memset(u, 0, sizeof(*u));
+    /* Some units are template instances, ListUnitFiles only knows templates */
+    snprintf(u->name, sizeof(u->name), idx % 50 ? "mock-%07u.%s" : "mock@%07u.%s", idx, type);
+    snprintf(u->path, sizeof(u->path), MOCK_UNIT_PREFIX "/mock_2d%07u_2e%s", idx, type);
+    snprintf(u->description, sizeof(u->description), "Synthetic %s unit number %u", type, idx);
+    u->type = type;
+    u->load = "loaded";
+    u->active = (idx % 3) ? "active" : "inactive";
+    u->sub = (idx % 3) ? "running" : "dead";
+    u->file_state = (idx % 4) ? "enabled" : "disabled";
+    u->restarts = (idx / 10) % 7;
+    u->alive = true;
+    n_alive++;
+}
+
+static bool mock_has_unit_file(const struct unit *u)
+{
+    return strcmp(u->type, "device") && strcmp(u->type, "scope");
+}
+
+static struct unit * mock_unit_by_path(const char *path)
+{
+    unsigned idx;
+    char type[16];
+
+    if (sscanf(path, MOCK_UNIT_PREFIX "/mock_2d%7u_2e%15s", &idx, type) != 2)
+        return NULL;
+    if (idx >= n_units || !units[idx].alive)
+        return NULL;
+    return &units[idx];
+}
+
+static struct unit * mock_unit_by_name(const char *name)
+{
+    unsigned idx;
+    char type[16];
+
+    if (sscanf(name, "mock%*1[-@]%7u.%15s", &idx, type) != 2)
+        return NULL;
+    if (idx >= n_units || !units[idx].alive)
+        return NULL;
+    return &units[idx];
+}
+
+/* Append a single property value as a variant, returns 0 if the property is unknown */
+static int mock_append_property(sd_bus_message *m, struct unit *u, const char *iface, const char *name)
+{
+    static const uint8_t invocation[16] = {
+        0xde, 0xad, 0xbe, 0xef, 0x00, 0x11, 0x22, 0x33,
+        0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb
+    };
+    char buf[192];
+
+    if (strcmp(iface, MOCK_IFACE("Unit")) == 0) {
+        if (strcmp(name, "Id") == 0)
+            return sd_bus_message_append(m, "v", "s", u->name) < 0 ? -1 : 1;
+        if (strcmp(name, "Description") == 0)
+            return sd_bus_message_append(m, "v", "s", u->description) < 0 ? -1 : 1;
+        if (strcmp(name, "LoadState") == 0)
+            return sd_bus_message_append(m, "v", "s", u->load) < 0 ? -1 : 1;
+        if (strcmp(name, "ActiveState") == 0)
+            return sd_bus_message_append(m, "v", "s", u->active) < 0 ? -1 : 1;
+        if (strcmp(name, "SubState") == 0)
+            return sd_bus_message_append(m, "v", "s", u->sub) < 0 ? -1 : 1;
+        if (strcmp(name, "UnitFileState") == 0)
+            return sd_bus_message_append(m, "v", "s", mock_has_unit_file(u) ? u->file_state : "") < 0 ? -1 : 1;
+        if (strcmp(name, "FragmentPath") == 0) {
+            snprintf(buf, sizeof(buf), "/usr/lib/systemd/system/%s", u->name);
+            return sd_bus_message_append(m, "v", "s", mock_has_unit_file(u) ? buf : "") < 0 ? -1 : 1;
+        }
+        if (strcmp(name, "InvocationID") == 0) {
+            if (sd_bus_message_open_container(m, 'v', "ay") < 0)
+                return -1;
+            if (sd_bus_message_append_array(m, 'y', invocation, sizeof(invocation)) < 0)
+                return -1;
+            return sd_bus_message_close_container(m) < 0 ? -1 : 1;
+        }
+        return 0;
+    }
+
+    if (strcmp(iface, MOCK_IFACE("Service")) == 0
+     || strcmp(iface, MOCK_IFACE("Scope")) == 0
+     || strcmp(iface, MOCK_IFACE("Slice")) == 0) {
+        if (strcmp(name, "ControlGroup") == 0) {
+            snprintf(buf, sizeof(buf), "/system.slice/%s", u->name);
+            return sd_bus_message_append(m, "v", "s", buf) < 0 ? -1 : 1;
+        }
+        if (strcmp(name, "ExecMainStartTimestamp") == 0)
+            return sd_bus_message_append(m, "v", "t", (uint64_t)1700000000000000ULL) < 0 ? -1 : 1;
+        if (strcmp(name, "ExecMainPID") == 0)
+            return sd_bus_message_append(m, "v", "u", (uint32_t)(u - units) + 100) < 0 ? -1 : 1;
+        if (strcmp(name, "NRestarts") == 0)
+            return sd_bus_message_append(m, "v", "u", u->restarts) < 0 ? -1 : 1;
+        if (strcmp(name, "TasksCurrent") == 0 || strcmp(name, "TasksMax") == 0
+         || strcmp(name, "MemoryCurrent") == 0 || strcmp(name, "MemoryPeak") == 0
+         || strcmp(name, "MemorySwapCurrent") == 0 || strcmp(name, "MemorySwapPeak") == 0
+         || strcmp(name, "MemoryZSwapCurrent") == 0 || strcmp(name, "CPUUsageNSec") == 0)
+            return sd_bus_message_append(m, "v", "t", (uint64_t)(u - units) * 4096) < 0 ? -1 : 1;
+        return 0;
+    }
+
+    if (strcmp(iface, MOCK_IFACE("Device")) == 0 && strcmp(name, "SysFSPath") == 0)
+        return sd_bus_message_append(m, "v", "s", "/sys/devices/mock") < 0 ? -1 : 1;
+    if (strcmp(iface, MOCK_IFACE("Mount")) == 0 && strcmp(name, "Where") == 0)
+        return sd_bus_message_append(m, "v", "s", "/mnt/mock") < 0 ? -1 : 1;
+    if (strcmp(iface, MOCK_IFACE("Mount")) == 0 && strcmp(name, "What") == 0)
+        return sd_bus_message_append(m, "v", "s", "/dev/mock") < 0 ? -1 : 1;
+    if (strcmp(iface, MOCK_IFACE("Timer")) == 0 && strcmp(name, "NextElapseUSecRealtime") == 0)
+        return sd_bus_message_append(m, "v", "t", (uint64_t)1900000000000000ULL) < 0 ? -1 : 1;
+    if (strcmp(iface, MOCK_IFACE("Socket")) == 0 && strcmp(name, "BindIPv6Only") == 0)
+        return sd_bus_message_append(m, "v", "s", "default") < 0 ? -1 : 1;
+    if (strcmp(iface, MOCK_IFACE("Socket")) == 0 && strcmp(name, "Backlog") == 0)
+        return sd_bus_message_append(m, "v", "u", (uint32_t)4096) < 0 ? -1 : 1;
+
+    return 0;
+}
+
+/* Which properties GetAll reports per interface */
+static const struct {
+    const char *iface;
+    const char *name;
+} mock_properties[] = {
+    { MOCK_IFACE("Unit"), "Id" },
+    { MOCK_IFACE("Unit"), "Description" },
+    { MOCK_IFACE("Unit"), "LoadState" },
+    { MOCK_IFACE("Unit"), "ActiveState" },
+    { MOCK_IFACE("Unit"), "SubState" },
+    { MOCK_IFACE("Unit"), "UnitFileState" },
+    { MOCK_IFACE("Unit"), "FragmentPath" },
+    { MOCK_IFACE("Unit"), "InvocationID" },
+    { MOCK_IFACE("Service"), "ControlGroup" },
+    { MOCK_IFACE("Service"), "ExecMainStartTimestamp" },
+    { MOCK_IFACE("Service"), "ExecMainPID" },
+    { MOCK_IFACE("Service"), "NRestarts" },
+    { MOCK_IFACE("Service"), "TasksCurrent" },
+    { MOCK_IFACE("Service"), "TasksMax" },
+    { MOCK_IFACE("Service"), "MemoryCurrent" },
+    { MOCK_IFACE("Service"), "MemoryPeak" },
+    { MOCK_IFACE("Service"), "MemorySwapCurrent" },
+    { MOCK_IFACE("Service"), "MemorySwapPeak" },
+    { MOCK_IFACE("Service"), "MemoryZSwapCurrent" },
+    { MOCK_IFACE("Service"), "CPUUsageNSec" },
+    { MOCK_IFACE("Device"), "SysFSPath" },
+    { MOCK_IFACE("Mount"), "Where" },
+    { MOCK_IFACE("Mount"), "What" },
+    { MOCK_IFACE("Timer"), "NextElapseUSecRealtime" },
+    { MOCK_IFACE("Socket"), "BindIPv6Only" },
+    { MOCK_IFACE("Socket"), "Backlog" },
+};
+
+static int mock_unit_object(sd_bus_message *m, void *data, sd_bus_error *err)
+{
+    sd_bus_message *reply = NULL;
+    struct unit *u;
+    const char *iface, *name;
+    int rc;
+
+    (void)data;
+    (void)err;
+
+    u = mock_unit_by_path(sd_bus_message_get_path(m));
+    if (!u)
+        return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_UNKNOWN_OBJECT, "No such unit");
+
+    if (sd_bus_message_is_method_call(m, "org.freedesktop.DBus.Properties", "Get")) {
+        if (sd_bus_message_read(m, "ss", &iface, &name) < 0)
+            return -EINVAL;
+        if (sd_bus_message_new_method_return(m, &reply) < 0)
+            return -ENOMEM;
+        rc = mock_append_property(reply, u, iface, name);
+        if (rc <= 0) {
+            sd_bus_message_unref(reply);
+            return sd_bus_reply_method_errorf(m, SD_BUS_ERROR_UNKNOWN_PROPERTY, "Unknown property %s", name);
+        }
+        rc = sd_bus_send(NULL, reply, NULL);
+        sd_bus_message_unref(reply);
+        return rc < 0 ? rc : 1;
+    }
+
+    if (sd_bus_message_is_method_call(m, "org.freedesktop.DBus.Properties", "GetAll")) {
+        if (sd_bus_message_read(m, "s", &iface) < 0)
+            return -EINVAL;
+        if (sd_bus_message_new_method_return(m, &reply) < 0)
+            return -ENOMEM;
+        sd_bus_message_open_container(reply, 'a', "{sv}");
+        for (size_t i = 0; i < sizeof(mock_properties) / sizeof(*mock_properties); i++) {
+            if (strcmp(mock_properties[i].iface, iface))
+                continue;
+            sd_bus_message_open_container(reply, 'e', "sv");
+            sd_bus_message_append(reply, "s", mock_properties[i].name);
+            mock_append_property(reply, u, iface, mock_properties[i].name);
+            sd_bus_message_close_container(reply);
+        }
+        sd_bus_message_close_container(reply);
+        rc = sd_bus_send(NULL, reply, NULL);
+        sd_bus_message_unref(reply);
+        return rc < 0 ? rc : 1;
+    }
+
+    return 0;
+}
+
+static int mock_list_units(sd_bus_message *m)
+{
+    sd_bus_message *reply = NULL;
+    int rc;
+
+    if (sd_bus_message_new_method_return(m, &reply) < 0)
+        return -ENOMEM;
+
+    sd_bus_message_open_container(reply, 'a', "(ssssssouso)");
+    for (unsigned i = 0; i < n_units; i++) {
+        struct unit *u = &units[i];
+        if (!u->alive)
+            continue;
+        rc = sd_bus_message_append(reply, "(ssssssouso)",
+                                   u->name, u->description, u->load, u->active, u->sub,
+                                   "", u->path, (uint32_t)0, "", "/");
+        if (rc < 0)
+            return rc;
+    }
+    sd_bus_message_close_container(reply);
+
+    rc = sd_bus_send(NULL, reply, NULL);
+    sd_bus_message_unref(reply);
+    return rc < 0 ? rc : 1;
+}
+
+/* Units which are not loaded are left out, the real manager would load them */
+static int mock_list_units_by_names(sd_bus_message *m)
+{
+    sd_bus_message *reply = NULL;
+    char **names = NULL;
+    struct unit *u;
+    int rc;
+
+    if (sd_bus_message_read_strv(m, &names) < 0)
+        return -EINVAL;
+
+    if (sd_bus_message_new_method_return(m, &reply) < 0)
+        return -ENOMEM;
+
+    sd_bus_message_open_container(reply, 'a', "(ssssssouso)");
+    for (char **n = names; n && *n; n++) {
+        u = mock_unit_by_name(*n);
+        if (u)
+            sd_bus_message_append(reply, "(ssssssouso)",
+                                  u->name, u->description, u->load, u->active, u->sub,
+                                  "", u->path, (uint32_t)0, "", "/");
+        free(*n);
+    }
+    free(names);
+    sd_bus_message_close_container(reply);
+
+    rc = sd_bus_send(NULL, reply, NULL);
+    sd_bus_message_unref(reply);
+    return rc < 0 ? rc : 1;
+}
+
+static int mock_list_unit_files(sd_bus_message *m)
+{
+    sd_bus_message *reply = NULL;
+    char path[192];
+    int rc;
+
+    if (sd_bus_message_new_method_return(m, &reply) < 0)
+        return -ENOMEM;
+
+    sd_bus_message_open_container(reply, 'a', "(ss)");
+    for (unsigned i = 0; i < n_units; i++) {
+        struct unit *u = &units[i];
+        if (!u->alive || !mock_has_unit_file(u) || strchr(u->name, '@'))
+            continue;
+        snprintf(path, sizeof(path), "/usr/lib/systemd/system/%s", u->name);
+        rc = sd_bus_message_append(reply, "(ss)", path, u->file_state);
+        if (rc < 0)
+            return rc;
+    }
+    sd_bus_message_close_container(reply);
+
+    rc = sd_bus_send(NULL, reply, NULL);
+    sd_bus_message_unref(reply);
+    return rc < 0 ? rc : 1;
+}
+
+static void mock_set_active(struct unit *u, bool active)
+{
+    u->active = active ? "active" : "inactive";
+    u->sub = active ? "running" : "dead";
+    sd_bus_emit_signal(bus, u->path, "org.freedesktop.DBus.Properties", "PropertiesChanged",
+                       "sa{sv}as", MOCK_IFACE("Unit"), 2,
+                       "ActiveState", "s", u->active,
+                       "SubState", "s", u->sub,
+                       0);
+}
+
+/* How long jobs take to finish, set with -j */
+static uint64_t job_usec = 20000;
+
+struct mock_job {
+    unsigned id;
+    char path[64];
+    struct unit *unit;
+    bool start;
+};
+
+static int mock_job_finish(sd_event_source *s, uint64_t usec, void *data)
+{
+    struct mock_job *job = data;
+
+    (void)usec;
+
+    mock_set_active(job->unit, job->start);
+    sd_bus_emit_signal(bus, MOCK_OPATH, MOCK_IFACE("Manager"), "JobRemoved", "uoss",
+                       job->id, job->path, job->unit->name, "done");
+    sd_event_source_unref(s);
+    free(job);
+    return 0;
+}
+
+static int mock_unit_job(sd_bus_message *m, bool start, bool stop)
+{
+    struct mock_job *job;
+    const char *name, *mode;
+    sd_event *ev = NULL;
+    struct unit *u;
+    uint64_t now;
+
+    if (sd_bus_message_read(m, "ss", &name, &mode) < 0)
+        return -EINVAL;
+
+    u = mock_unit_by_name(name);
+    if (!u)
+        return sd_bus_reply_method_errorf(m, "org.freedesktop.systemd1.NoSuchUnit", "Unit %s not loaded.", name);
+
+    job = calloc(1, sizeof(*job));
+    if (!job)
+        return -ENOMEM;
+    job->id = next_job++;
+    job->unit = u;
+    job->start = start || !stop;
+    snprintf(job->path, sizeof(job->path), MOCK_JOB_PREFIX "/%u", job->id);
+
+    if (sd_bus_reply_method_return(m, "o", job->path) < 0)
+        return -EIO;
+
+    sd_bus_emit_signal(bus, MOCK_OPATH, MOCK_IFACE("Manager"), "JobNew", "uos",
+                       job->id, job->path, u->name);
+
+    /* Complete the job a little later, like a real unit would */
+    sd_event_default(&ev);
+    sd_event_now(ev, CLOCK_MONOTONIC, &now);
+    sd_event_add_time(ev, NULL, CLOCK_MONOTONIC, now + job_usec, 0, mock_job_finish, job);
+    sd_event_unref(ev);
+    return 1;
+}
+
+static int mock_unit_files_changed(sd_bus_message *m, const char *state)
+{
+    char **names = NULL;
+    struct unit *u;
+
+    if (sd_bus_message_read_strv(m, &names) < 0)
+        return -EINVAL;
+
+    for (char **n = names; n && *n; n++) {
+        u = mock_unit_by_name(*n);
+        if (u)
+            u->file_state = state;
+        free(*n);
+    }
+    free(names);
+
+    if (strcmp(state, "enabled") == 0 || strcmp(state, "masked") == 0)
+        sd_bus_reply_method_return(m, "ba(sss)", 0, 0);
+    else
+        sd_bus_reply_method_return(m, "a(sss)", 0);
+
+    sd_bus_emit_signal(bus, MOCK_OPATH, MOCK_IFACE("Manager"), "UnitFilesChanged", "");
+    return 1;
+}
+
+/* Emit a PropertiesChanged storm over the first n units */
+static void mock_storm(unsigned n)
+{
+    for (unsigned i = 0; i < n && i < n_units; i++) {
+        if (!units[i].alive)
+            continue;
+        mock_set_active(&units[i], strcmp(units[i].active, "active") != 0);
+    }
+}
+
+/* Remove n units from the tail and create n new ones */
+static void mock_churn(unsigned n)
+{
+    unsigned removed = 0;
+
+    for (unsigned i = n_units; i > 0 && removed < n; i--) {
+        struct unit *u = &units[i - 1];
+        if (!u->alive)
+            continue;
+        u->alive = false;
+        n_alive--;
+        removed++;
+        sd_bus_emit_signal(bus, MOCK_OPATH, MOCK_IFACE("Manager"), "UnitRemoved", "so", u->name, u->path);
+    }
+
+    for (unsigned i = 0; i < n; i++) {
+        mock_unit_add(n_units);
+        sd_bus_emit_signal(bus, MOCK_OPATH, MOCK_IFACE("Manager"), "UnitNew", "so",
+                           units[n_units - 1].name, units[n_units - 1].path);
+    }
+}
+
+/* Remove the first n units, as happens when transient units go away */
+static void mock_drop(unsigned n)
+{
+    unsigned removed = 0;
+
+    for (unsigned i = 0; i < n_units && removed < n; i++) {
+        struct unit *u = &units[i];
+        if (!u->alive)
+            continue;
+        u->alive = false;
+        n_alive--;
+        removed++;
+        sd_bus_emit_signal(bus, MOCK_OPATH, MOCK_IFACE("Manager"), "UnitRemoved", "so", u->name, u->path);
+    }
+}
+
+/* As the manager does on daemon-reload, every unit is freed and loaded again */
+static void mock_reload(void)
+{
+    sd_bus_emit_signal(bus, MOCK_OPATH, MOCK_IFACE("Manager"), "Reloading", "b", 1);
+
+    for (unsigned i = 0; i < n_units; i++) {
+        if (units[i].alive)
+            sd_bus_emit_signal(bus, MOCK_OPATH, MOCK_IFACE("Manager"), "UnitRemoved", "so", units[i].name, units[i].path);
+    }
+    for (unsigned i = 0; i < n_units; i++) {
+        if (units[i].alive)
+            sd_bus_emit_signal(bus, MOCK_OPATH, MOCK_IFACE("Manager"), "UnitNew", "so", units[i].name, units[i].path);
+    }
+
+    sd_bus_emit_signal(bus, MOCK_OPATH, MOCK_IFACE("Manager"), "Reloading", "b", 0);
+}
+
+static int mock_manager_object(sd_bus_message *m, void *data, sd_bus_error *err)
+{
+    const char *iface, *name;
+    unsigned n;
+
+    (void)data;
+    (void)err;
+
+    if (sd_bus_message_is_method_call(m, MOCK_IFACE("Manager"), "ListUnits"))
+        return mock_list_units(m);
+    if (sd_bus_message_is_method_call(m, MOCK_IFACE("Manager"), "ListUnitFiles"))
+        return mock_list_unit_files(m);
+    if (sd_bus_message_is_method_call(m, MOCK_IFACE("Manager"), "ListUnitsByNames"))
+        return mock_list_units_by_names(m);
+    if (sd_bus_message_is_method_call(m, MOCK_IFACE("Manager"), "Subscribe"))
+        return sd_bus_reply_method_return(m, "");
+    if (sd_bus_message_is_method_call(m, MOCK_IFACE("Manager"), "GetUnitFileState")) {
+        struct unit *u;
+        if (sd_bus_message_read(m, "s", &name) < 0)
+            return -EINVAL;
+        u = mock_unit_by_name(name);
+        if (!u)
+            return sd_bus_reply_method_errorf(m, "org.freedesktop.systemd1.NoSuchUnit", "No such file");
+        return sd_bus_reply_method_return(m, "s", u->file_state);
+    }
+    if (sd_bus_message_is_method_call(m, MOCK_IFACE("Manager"), "StartUnit")
+     || sd_bus_message_is_method_call(m, MOCK_IFACE("Manager"), "RestartUnit")
+     || sd_bus_message_is_method_call(m, MOCK_IFACE("Manager"), "ReloadUnit"))
+        return mock_unit_job(m, true, false);
+    if (sd_bus_message_is_method_call(m, MOCK_IFACE("Manager"), "StopUnit"))
+        return mock_unit_job(m, false, true);
+    if (sd_bus_message_is_method_call(m, MOCK_IFACE("Manager"), "EnableUnitFiles"))
+        return mock_unit_files_changed(m, "enabled");
+    if (sd_bus_message_is_method_call(m, MOCK_IFACE("Manager"), "DisableUnitFiles"))
+        return mock_unit_files_changed(m, "disabled");
+    if (sd_bus_message_is_method_call(m, MOCK_IFACE("Manager"), "MaskUnitFiles"))
+        return mock_unit_files_changed(m, "masked");
+    if (sd_bus_message_is_method_call(m, MOCK_IFACE("Manager"), "UnmaskUnitFiles"))
+        return mock_unit_files_changed(m, "disabled");
+
+    if (sd_bus_message_is_method_call(m, MOCK_CONTROL, "Storm")) {
+        if (sd_bus_message_read(m, "u", &n) < 0)
+            return -EINVAL;
+        mock_storm(n);
+        return sd_bus_reply_method_return(m, "");
+    }
+    if (sd_bus_message_is_method_call(m, MOCK_CONTROL, "Reload")) {
+        mock_reload();
+        return sd_bus_reply_method_return(m, "");
+    }
+    if (sd_bus_message_is_method_call(m, MOCK_CONTROL, "Churn")) {
+        if (sd_bus_message_read(m, "u", &n) < 0)
+            return -EINVAL;
+        mock_churn(n);
+        return sd_bus_reply_method_return(m, "");
+    }
+    if (sd_bus_message_is_method_call(m, MOCK_CONTROL, "Drop")) {
+        if (sd_bus_message_read(m, "u", &n) < 0)
+            return -EINVAL;
+        mock_drop(n);
+        return sd_bus_reply_method_return(m, "");
+    }
+    if (sd_bus_message_is_method_call(m, MOCK_CONTROL, "Count"))
+        return sd_bus_reply_method_return(m, "u", n_alive);
+
+    if (sd_bus_message_is_method_call(m, "org.freedesktop.DBus.Properties", "Get")) {
+        if (sd_bus_message_read(m, "ss", &iface, &name) < 0)
+            return -EINVAL;
+        if (strcmp(name, "Version") == 0)
+            return sd_bus_reply_method_return(m, "v", "s", "mock");
+    }
+
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-n units] [-j job usec]\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    sd_event *ev = NULL;
+    unsigned count = 1000;
+    int c, rc;
+
+    while ((c = getopt(argc, argv, "n:j:")) != -1) {
+        switch (c) {
+            case 'n':
+                count = strtoul(optarg, NULL, 10);
+                break;
+            case 'j':
+                job_usec = strtoull(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    for (unsigned i = 0; i < count; i++)
+        mock_unit_add(i);
+
+    rc = sd_event_default(&ev);
+    if (rc < 0)
+        goto fail;
+
+    rc = sd_bus_open_user(&bus);
+    if (rc < 0)
+        goto fail;
+
+    rc = sd_bus_add_object(bus, NULL, MOCK_OPATH, mock_manager_object, NULL);
+    if (rc < 0)
+        goto fail;
+
+    rc = sd_bus_add_fallback(bus, NULL, MOCK_UNIT_PREFIX, mock_unit_object, NULL);
+    if (rc < 0)
+        goto fail;
+
+    rc = sd_bus_attach_event(bus, ev, SD_EVENT_PRIORITY_NORMAL);
+    if (rc < 0)
+        goto fail;
+
+    /* Only take the name once everything is in place, readers wait for it */
+    rc = sd_bus_request_name(bus, MOCK_DESTINATION, 0);
+    if (rc < 0)
+        goto fail;
+
+    rc = sd_event_loop(ev);
+    if (rc < 0)
+        goto fail;
+
+    return EXIT_SUCCESS;
+
+fail:
+    fprintf(stderr, "mock-systemd: %s\n", strerror(-rc));
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,36 @@
+#!/bin/sh
+# Runs sm-bench against mock-systemd on a private bus, no systemd is needed.
+#
+# Usage: run-bench.sh DBUS_DAEMON MOCK_SYSTEMD SM_BENCH UNITS [SIGNALS]
+set -eu
+
+dbus_daemon=$1
+mock=$2
+bench=$3
+units=$4
+signals=${5:-10000}
+
+dir=$(mktemp -d)
+bus_pid=
+mock_pid=
+cleanup() {
+    [ -n "$mock_pid" ] && kill "$mock_pid" 2>/dev/null
+    [ -n "$bus_pid" ] && kill "$bus_pid" 2>/dev/null
+    rm -rf "$dir"
+}
+trap cleanup EXIT INT TERM
+
+"$dbus_daemon" --config-file="$(dirname "$0")/bus.conf" --address="unix:path=$dir/bus" --nofork --nopidfile &
+bus_pid=$!
+while [ ! -S "$dir/bus" ]; do
+    kill -0 "$bus_pid" 2>/dev/null || exit 1
+    sleep 0.05
+done
+
+# The mock serves the bus as its session bus, servicemaster reads it as the
+# system bus and finds no user bus
+DBUS_SESSION_BUS_ADDRESS="unix:path=$dir/bus" "$mock" -n "$units" &
+mock_pid=$!
+
+env -u DBUS_SESSION_BUS_ADDRESS -u XDG_RUNTIME_DIR DBUS_SYSTEM_BUS_ADDRESS="unix:path=$dir/bus" \
+    "$bench" -s "$signals"
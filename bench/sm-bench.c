@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <curses.h>
+#include <sys/resource.h>
+#include <systemd/sd-bus.h>
+#include "../sm_err.h"
+#include "../bus.h"
+#include "../display.h"
+
+/*
+ * Runs the bus and service code of servicemaster against the manager on the
+ * system bus, usually mock-systemd on a private bus, see run-bench.sh. The
+ * screen is rendered into a terminal that writes to /dev/null.
+ */
+
+#define BENCH_NAME_WAIT_USEC 10000000LLU
+#define BENCH_CONTROL "org.servicemaster.Mock"
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-s signals] [-c churn]\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+/* The event loop caches its time once it runs, the bench needs the clock */
+static uint64_t bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LLU + ts.tv_nsec / 1000;
+}
+
+/* Wait until the manager owns its name, the mock may still be starting */
+static void bench_wait_manager(void)
+{
+    sd_bus_message *reply = NULL;
+    sd_bus *bus = NULL;
+    uint64_t end = bench_now() + BENCH_NAME_WAIT_USEC;
+    int owned = 0;
+    int rc;
+
+    rc = sd_bus_open_system(&bus);
+    if (rc < 0)
+        sm_err_set("Cannot connect to the system bus: %s", strerror(-rc));
+
+    while (!owned && bench_now() < end) {
+        rc = sd_bus_call_method(bus,
+                                "org.freedesktop.DBus",
+                                "/org/freedesktop/DBus",
+                                "org.freedesktop.DBus",
+                                "NameHasOwner",
+                                NULL,
+                                &reply,
+                                "s",
+                                SD_DESTINATION);
+        if (rc < 0)
+            sm_err_set("Cannot ask for %s: %s", SD_DESTINATION, strerror(-rc));
+
+        rc = sd_bus_message_read(reply, "b", &owned);
+        if (rc < 0)
+            sm_err_set("Cannot ask for %s: %s", SD_DESTINATION, strerror(-rc));
+        reply = sd_bus_message_unref(reply);
+
+        if (!owned)
+            usleep(50000);
+    }
+
+    sd_bus_flush_close_unref(bus);
+    if (!owned)
+        sm_err_set("%s did not appear on the system bus", SD_DESTINATION);
+}
+
+/* Run the event loop until every change the manager announced is applied */
+static void bench_settle(Bus *bus)
+{
+    sd_event *ev = NULL;
+    int rc;
+
+    rc = sd_event_default(&ev);
+    if (rc < 0)
+        sm_err_set("Cannot fetch event loop: %s", strerror(-rc));
+
+    while (bus->files_slot || bus->units_slot
+           || bus->n_new_units || bus->n_removed || bus->by_names_inflight) {
+        rc = sd_event_run(ev, UINT64_MAX);
+        if (rc < 0)
+            sm_err_set("Cannot run event loop: %s", strerror(-rc));
+    }
+
+    sd_event_unref(ev);
+}
+
+/* Callback which receives the reply of a control method */
+static int bench_control_reply(sd_bus_message *reply, void *data, sd_bus_error *err)
+{
+    bool *done = (bool *)data;
+
+    (void)err;
+
+    if (sd_bus_message_is_method_error(reply, NULL))
+        sm_err_set("Cannot call control method: %s", sd_bus_message_get_error(reply)->message);
+
+    *done = true;
+    return 0;
+}
+
+/**
+ * Calls a method of the mock's control interface on the connection
+ * servicemaster uses, and runs the event loop until the reply is in. The
+ * mock emits its signals before it replies, so by then they have all been
+ * handled, as they arrived, the way servicemaster handles them.
+ *
+ * @param bus The bus servicemaster reads.
+ * @param method The control method, e.g. "Reload".
+ * @param arg The argument of methods which take a count.
+ * @return The time it took in usec.
+ */
+static uint64_t bench_control(Bus *bus, const char *method, unsigned arg)
+{
+    sd_event *ev = NULL;
+    uint64_t start = bench_now();
+    bool done = false;
+    int rc;
+
+    if (strcmp(method, "Reload") == 0)
+        rc = sd_bus_call_method_async(bus->bus, NULL, SD_DESTINATION, SD_OPATH, BENCH_CONTROL, method,
+                                      bench_control_reply, &done, NULL);
+    else
+        rc = sd_bus_call_method_async(bus->bus, NULL, SD_DESTINATION, SD_OPATH, BENCH_CONTROL, method,
+                                      bench_control_reply, &done, "u", arg);
+    if (rc < 0)
+        sm_err_set("Cannot call %s: %s", method, strerror(-rc));
+
+    rc = sd_event_default(&ev);
+    if (rc < 0)
+        sm_err_set("Cannot fetch event loop: %s", strerror(-rc));
+
+    while (!done) {
+        rc = sd_event_run(ev, UINT64_MAX);
+        if (rc < 0)
+            sm_err_set("Cannot run event loop: %s", strerror(-rc));
+    }
+    sd_event_unref(ev);
+
+    /* Units announced, removed or changed by a reload are fetched afterwards */
+    bench_settle(bus);
+
+    return bench_now() - start;
+}
+
+/* Render a frame of the list into the null terminal */
+static uint64_t bench_frame(Bus *bus)
+{
+    uint64_t start = bench_now();
+
+    display_redraw(bus);
+    refresh();
+    return bench_now() - start;
+}
+
+int main(int argc, char **argv)
+{
+    struct rusage usage_self;
+    unsigned signals = 10000, churn = 1000;
+    uint64_t start, first_frame, reload, storm, frame, churned;
+    FILE *null = NULL;
+    Bus *bus = NULL;
+    int c;
+
+    while ((c = getopt(argc, argv, "s:c:")) != -1) {
+        switch (c) {
+            case 's':
+                signals = strtoul(optarg, NULL, 10);
+                break;
+            case 'c':
+                churn = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    bench_wait_manager();
+
+    /* A fixed screen size keeps runs comparable */
+    setenv("LINES", "50", 1);
+    setenv("COLUMNS", "200", 1);
+    null = fopen("/dev/null", "r+");
+    if (!null || !newterm(getenv("TERM") ? getenv("TERM") : "vt100", null, null))
+        sm_err_set("Cannot open a terminal on /dev/null");
+
+    display_set_bus_type(SYSTEM);
+
+    start = bench_now();
+    bus_init();
+    bus = bus_currently_displayed();
+    bench_frame(bus);
+    first_frame = bench_now() - start;
+
+    reload = bench_control(bus, "Reload", 0);
+
+    /* The mock changes each unit once per storm */
+    if (signals > (unsigned)bus->by_type[ALL].len)
+        signals = bus->by_type[ALL].len;
+    storm = bench_control(bus, "Storm", signals);
+    frame = bench_frame(bus);
+
+    /* Transient units come and go, the mock replaces the newest ones */
+    if (churn > (unsigned)bus->by_type[ALL].len)
+        churn = bus->by_type[ALL].len;
+    churned = bench_control(bus, "Churn", churn);
+
+    endwin();
+    getrusage(RUSAGE_SELF, &usage_self);
+
+    printf("units          %d\n", bus->by_type[ALL].len);
+    printf("first frame    %.1f ms\n", first_frame / 1000.0);
+    printf("reload         %.1f ms\n", reload / 1000.0);
+    printf("signal         %.2f us (%u PropertiesChanged)\n", signals ? (double)storm / signals : 0, signals);
+    printf("frame          %.2f ms\n", frame / 1000.0);
+    printf("churn          %.1f ms (%u units replaced, %d listed)\n", churned / 1000.0, churn, bus->by_type[ALL].len);
+    printf("peak rss       %ld kB\n", usage_self.ru_maxrss);
+
+    return 0;
+}
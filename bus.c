@@ -1,10 +1,16 @@
 #include <systemd/sd-bus.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <errno.h>
+#include <stdio.h>
 
 #include "sm_err.h"
+#include "sm_hash.h"
+#include "sm_atom.h"
 #include "service.h"
 #include "bus.h"
 #include "display.h"
+#include "sm_stats.h"
 
 #define STS state[0]
 #define STSBUS state[0].bus
@@ -43,7 +49,7 @@ static int bus_update_service_property(Service *svc, sd_bus_message *reply)
         rc = sd_bus_message_read(reply, "v", "s", &active);
         if (rc < 0)
             sm_err_set("Cannot fetch value from dictionary: %s\n", strerror(-rc));
-        BUS_CPY_PROPERTY(svc, active);
+        svc->active = sm_atom(active);
 
         return 1;
     }
@@ -53,7 +59,17 @@ static int bus_update_service_property(Service *svc, sd_bus_message *reply)
         rc = sd_bus_message_read(reply, "v", "s", &sub);
         if (rc < 0)
             sm_err_set("Cannot fetch value from dictionary: %s\n", strerror(-rc));
-        BUS_CPY_PROPERTY(svc, sub);
+        svc->sub = sm_atom(sub);
+
+        return 1;
+    }
+
+    /* From the Service interface, shown and sorted by in the usage view */
+    else if (strcmp(k, "NRestarts") == 0) {
+        rc = sd_bus_message_read(reply, "v", "u", &svc->n_restarts);
+        if (rc < 0)
+            sm_err_set("Cannot fetch value from dictionary: %s\n", strerror(-rc));
+        service_usage_changed(svc);
 
         return 1;
     }
@@ -68,19 +84,21 @@ static int bus_update_service_property(Service *svc, sd_bus_message *reply)
 /** 
  * Callback function that handles changes to a systemd service.
  *  
- * This function is called when a change is detected in a systemd service. It reads the
- * updated properties from the D-Bus message and updates the corresponding fields in the
+ * This function is called for every PropertiesChanged signal below the unit object
+ * namespace. It finds the affected service by its object path, reads the updated
+ * properties from the D-Bus message and updates the corresponding fields in the
  * Service struct. If any properties have changed, it redraws the screen to reflect the
  * updated service status.
  *  
  * @param reply The D-Bus message containing the updated service properties.
- * @param data A pointer to the Service struct to be updated.
+ * @param data A pointer to the bus the signal was received on.
  * @param err An error object, if an error occurred.
  * @return 0 on success, or a negative error code on failure.
  */     
 static int bus_unit_changed(sd_bus_message *reply, void *data, sd_bus_error *err)
 {
-    Service *svc = (Service *)data;
+    Bus *bus = (Bus *)data;
+    Service *svc = NULL;
     const char *iface = NULL;
     int rc;
     
@@ -89,13 +107,19 @@ static int bus_unit_changed(sd_bus_message *reply, void *data, sd_bus_error *err
     if (sd_bus_error_is_set(err))
         sm_err_set("Changed unit callback failed: %s\n", err->message);
 
+    /* Units we have not enumerated yet are picked up on the next refresh */
+    svc = service_get_object(bus, sd_bus_message_get_path(reply));
+    sm_stats_signal(svc != NULL);
+    if (!svc)
+        goto fin;
+
     /* s: Interface name */
     rc = sd_bus_message_read(reply, "s", &iface);
     if (rc < 0)
         sm_err_set("Cannot read dbus messge: %s\n", strerror(-rc));
     
-    /* If the interface is not a unit, we dont care */
-    if (strcmp(iface, SD_IFACE("Unit")) != 0)
+    /* If the interface is not a unit or service, we dont care */
+    if (strcmp(iface, SD_IFACE("Unit")) != 0 && strcmp(iface, SD_IFACE("Service")) != 0)
         goto fin;
             
     /* a: Array of dictionaries */
@@ -115,10 +139,10 @@ static int bus_unit_changed(sd_bus_message *reply, void *data, sd_bus_error *err
             break;
 
         svc->changed += bus_update_service_property(svc, reply);
-        if (svc->changed) {
-            display_redraw_row(svc);
+
+        /* A unit stamped 0 was removed and waits for the sweep, it stays removed */
+        if (svc->changed && svc->last_update)
             svc->last_update = service_now();
-        }
 
         if (sd_bus_message_exit_container(reply) < 0)
             sm_err_set("Cannot exit dictionary: %s\n", strerror(-rc));
@@ -126,10 +150,13 @@ static int bus_unit_changed(sd_bus_message *reply, void *data, sd_bus_error *err
 
     sd_bus_message_exit_container(reply);
 
-    /* Redraw screen if something changed */
+    /* Schedule a frame if something changed on the screen, bursts of
+     * signals are coalesced into a single redraw */
     if (svc->changed) {
         svc->changed = 0;
-        display_redraw(bus_currently_displayed());
+        if (display_service_row(svc) > -1)
+            display_schedule_redraw();
+        display_status_refresh(svc);
     }
 
 fin:
@@ -137,64 +164,487 @@ fin:
     return 0;
 }
 
+/* Decodes a property into the field at offset of the unit's details, according
+ * to its signature. The fields of the Service record itself are left to the
+ * unit list, the PropertiesChanged signals and the cgroup sampler. */
+struct bus_property {
+    const char *name;
+    const char *sig;
+    size_t offset;
+};
+
+#define BUS_DETAIL(f) offsetof(struct service_detail, f)
+
+static const struct bus_property bus_unit_properties[] = {
+    { "InvocationID",           "ay", BUS_DETAIL(invocation_id) },
+    { "FragmentPath",           "s",  BUS_DETAIL(fragment_path) },
+    { NULL }
+};
+
+static const struct bus_property bus_service_properties[] = {
+    { "ExecMainStartTimestamp", "t",  BUS_DETAIL(exec_main_start) },
+    { "ExecMainPID",            "u",  BUS_DETAIL(main_pid) },
+    { "NRestarts",              "u",  BUS_DETAIL(n_restarts) },
+    { "TasksCurrent",           "t",  BUS_DETAIL(tasks_current) },
+    { "TasksMax",               "t",  BUS_DETAIL(tasks_max) },
+    { "MemoryCurrent",          "t",  BUS_DETAIL(memory_current) },
+    { "MemoryPeak",             "t",  BUS_DETAIL(memory_peak) },
+    { "MemorySwapCurrent",      "t",  BUS_DETAIL(swap_current) },
+    { "MemorySwapPeak",         "t",  BUS_DETAIL(swap_peak) },
+    { "MemoryZSwapCurrent",     "t",  BUS_DETAIL(zswap_current) },
+    { "CPUUsageNSec",           "t",  BUS_DETAIL(cpu_usage) },
+    { "ControlGroup",           "s",  BUS_DETAIL(cgroup) },
+    { NULL }
+};
+
+static const struct bus_property bus_device_properties[] = {
+    { "SysFSPath",              "s",  BUS_DETAIL(sysfs_path) },
+    { NULL }
+};
+
+static const struct bus_property bus_mount_properties[] = {
+    { "Where",                  "s",  BUS_DETAIL(mount_where) },
+    { "What",                   "s",  BUS_DETAIL(mount_what) },
+    { NULL }
+};
+
+static const struct bus_property bus_timer_properties[] = {
+    { "NextElapseUSecRealtime", "t",  BUS_DETAIL(next_elapse) },
+    { NULL }
+};
+
+static const struct bus_property bus_socket_properties[] = {
+    { "BindIPv6Only",           "s",  BUS_DETAIL(bind_ipv6_only) },
+    { "Backlog",                "u",  BUS_DETAIL(backlog) },
+    { NULL }
+};
+
+/* The type specific interface and the properties shown for each unit type */
+static const struct {
+    const char *iface;
+    const struct bus_property *properties;
+} bus_type_properties[MAX_TYPES] = {
+    [SERVICE] = { SD_IFACE("Service"), bus_service_properties },
+    [DEVICE]  = { SD_IFACE("Device"),  bus_device_properties },
+    [MOUNT]   = { SD_IFACE("Mount"),   bus_mount_properties },
+    [TIMER]   = { SD_IFACE("Timer"),   bus_timer_properties },
+    [SOCKET]  = { SD_IFACE("Socket"),  bus_socket_properties },
+};
+
 /**
- * Retrieves a unit property from the D-Bus interface.
- *
- * @param bus The D-Bus connection to use.
- * @param object The D-Bus object path to query.
- * @param iface The D-Bus interface to query.
- * @param property The property to retrieve.
- * @param fmt The format string for the property value.
- * @param result A pointer to store the retrieved property value.
- * @param sz The size of the result buffer.
- * @return 0 on success, or a negative error code on failure.
+ * Formats a 128 bit invocation ID as 32 hex characters.
+ *
+ * @param dst The buffer to write to, at least 33 bytes long.
+ * @param id The ID bytes.
+ * @param len The number of ID bytes, anything but 16 means there is no ID.
  */
-static int bus_unit_property(Bus *bus, const char *object, const char *iface, const char *property, const char *fmt, void *result, int sz) {
-    sd_bus_error error = SD_BUS_ERROR_NULL;
-    sd_bus_message *reply = NULL;
-    void *data = NULL;
+static void bus_format_invocation_id(char *dst, const uint8_t *id, size_t len)
+{
+    /* There is no ID */
+    if (len != 16) {
+        strncpy(dst, "00000000000000000000000000000000", 33);
+        return;
+    }
+
+    for (size_t i = 0; i < len; i++)
+        snprintf(dst + i * 2, 3, "%02hhx", id[i]);
+}
+
+/**
+ * Reads the variant of a property into the details of a unit.
+ *
+ * @param reply The D-Bus message, positioned at the variant.
+ * @param svc The service to store the value in.
+ * @param prop The table entry describing the property.
+ */
+static void bus_decode_property(sd_bus_message *reply, Service *svc, const struct bus_property *prop)
+{
+    void *field = (char *)service_detail(svc) + prop->offset;
+    const char *str = NULL;
+    const void *bytes = NULL;
+    size_t len = 0;
+    int rc;
+
+    rc = sd_bus_message_enter_container(reply, 'v', prop->sig);
+    if (rc < 0)
+        sm_err_set("Cannot read property %s: %s\n", prop->name, strerror(-rc));
+
+    switch (*prop->sig) {
+        case 's':
+            rc = sd_bus_message_read(reply, "s", &str);
+            if (rc < 0)
+                break;
+            free(*(char **)field);
+            *(char **)field = strdup(str);
+            if (!*(char **)field)
+                sm_err_set("Failed to update %s property", prop->name);
+            break;
+
+        case 't':
+            rc = sd_bus_message_read(reply, "t", (uint64_t *)field);
+            break;
+
+        case 'u':
+            rc = sd_bus_message_read(reply, "u", (uint32_t *)field);
+            break;
+
+        case 'a':
+            rc = sd_bus_message_read_array(reply, 'y', &bytes, &len);
+            if (rc < 0)
+                break;
+            bus_format_invocation_id(field, bytes, len);
+            break;
+    }
+
+    if (rc < 0)
+        sm_err_set("Cannot read property %s: %s\n", prop->name, strerror(-rc));
+
+    rc = sd_bus_message_exit_container(reply);
+    if (rc < 0)
+        sm_err_set("Cannot exit property %s: %s\n", prop->name, strerror(-rc));
+}
+
+/* A GetAll call for the status window, only one unit is shown at a time */
+struct bus_status_call {
+    Service *svc;
+    const struct bus_property *properties;
+    sd_bus_slot *slot;
+};
+
+/* One call for the Unit interface and one for the type specific interface */
+static struct bus_status_call status_calls[2];
+static uint64_t status_started = 0;
+/* The first error of a refresh, shown once every call is answered */
+static char *status_error = NULL;
+
+/* Once every call of a refresh is answered, show the unit or why it failed */
+static void bus_unit_properties_done(Service *svc)
+{
+    if (status_calls[0].slot || status_calls[1].slot)
+        return;
+
+    sm_stats_latency(STATS_STATUS, sm_stats_now() - status_started);
+    if (status_error) {
+        display_status_failed(svc, status_error);
+        free(status_error);
+        status_error = NULL;
+        return;
+    }
+
+    display_status_update(svc);
+}
+
+/**
+ * Callback which receives the reply of an asynchronous GetAll call.
+ *
+ * The properties listed in the call's table are stored in the Service struct.
+ * Once all calls of a refresh are answered the status window is updated, or
+ * shows the error if a call failed.
+ *
+ * @param reply The D-Bus message containing the array of properties.
+ * @param data A pointer to the bus_status_call the reply belongs to.
+ * @param err An error object, if an error occurred.
+ * @return 0 on success.
+ */
+static int bus_unit_properties_reply(sd_bus_message *reply, void *data, sd_bus_error *err)
+{
+    struct bus_status_call *call = (struct bus_status_call *)data;
+    Service *svc = call->svc;
+    const struct bus_property *prop;
+    const char *name = NULL;
     int rc = 0;
 
-    rc = sd_bus_get_property(bus->bus,
-                    SD_DESTINATION,
-                    object,
-                    iface,
-                    property,
-                    &error,
-                    &reply,
-                    fmt);
+    call->slot = sd_bus_slot_unref(call->slot);
+
+    /* The unit may have vanished in the meantime, this is not fatal */
+    if (sd_bus_message_is_method_error(reply, NULL)) {
+        if (!status_error) {
+            status_error = strdup(sd_bus_message_get_error(reply)->message);
+            if (!status_error)
+                sm_err_set("Cannot allocate error message: %s\n", strerror(errno));
+        }
+        bus_unit_properties_done(svc);
+        goto fin;
+    }
+
+    rc = sd_bus_message_enter_container(reply, 'a', "{sv}");
+    if (rc < 0)
+        sm_err_set("Cannot read array in dbus message: %s\n", strerror(-rc));
+
+    while (true) {
+        rc = sd_bus_message_enter_container(reply, 'e', "sv");
+        if (rc < 0)
+            sm_err_set("Cannot read dict item in dbus message: %s\n", strerror(-rc));
+
+        /* No more array entries to read */
+        if (rc == 0)
+            break;
+
+        rc = sd_bus_message_read(reply, "s", &name);
+        if (rc < 0)
+            sm_err_set("Cannot read property name: %s\n", strerror(-rc));
+
+        for (prop = call->properties; prop->name; prop++) {
+            if (strcmp(prop->name, name) == 0)
+                break;
+        }
+
+        if (prop->name)
+            bus_decode_property(reply, svc, prop);
+        else {
+            rc = sd_bus_message_skip(reply, "v");
+            if (rc < 0)
+                sm_err_set("Cannot skip property %s: %s\n", name, strerror(-rc));
+        }
+
+        rc = sd_bus_message_exit_container(reply);
+        if (rc < 0)
+            sm_err_set("Cannot exit dictionary: %s\n", strerror(-rc));
+    }
 
+    rc = sd_bus_message_exit_container(reply);
     if (rc < 0)
-        sm_err_set("Cannot fetch object property: %s", strerror(-rc));
+        sm_err_set("Cannot exit array: %s\n", strerror(-rc));
 
-    if (sd_bus_error_is_set(&error)) 
-        sm_err_set("Cannot fetch object property: %s", error.message);
+    /* Memory and tasks of the list are sampled from the control group, the
+     * restart count is not, it may move the unit in the Restarts order */
+    if (svc->type == SERVICE && svc->n_restarts != service_detail(svc)->n_restarts) {
+        svc->n_restarts = svc->detail->n_restarts;
+        service_usage_changed(svc);
+    }
+    bus_unit_properties_done(svc);
 
-    rc = sd_bus_message_read(reply, fmt, &data);
-    if (rc < 0) 
-        sm_err_set("Cannot read object property: %s", strerror(-rc));
+fin:
+    sd_bus_error_free(err);
+    return 0;
+}
+
+/* Send a GetAll call for one interface of a unit */
+static void bus_unit_properties_all(Bus *bus, struct bus_status_call *call, Service *svc, const char *iface, const struct bus_property *props)
+{
+    int rc;
+
+    call->svc = svc;
+    call->properties = props;
+    sm_stats_call("GetAll");
+
+    rc = sd_bus_call_method_async(bus->bus,
+                                  &call->slot,
+                                  SD_DESTINATION,
+                                  svc->object,
+                                  "org.freedesktop.DBus.Properties",
+                                  "GetAll",
+                                  bus_unit_properties_reply,
+                                  (void *)call,
+                                  "s",
+                                  iface);
+    if (rc < 0)
+        sm_err_set("Cannot request unit properties: %s\n", strerror(-rc));
+}
 
-    if ((*fmt == 's' || *fmt== 'o') && sz > 0)
-        strncpy(result, data, sz);
-    else if ((*fmt == 's' || *fmt == 'o') && sz <= 0) {
-        *(char **)result = strdup(data);
+static void bus_unit_lookup_pump(Bus *bus);
+
+/* Queue asynchronous property lookups for a unit, merged with any already pending */
+static void bus_unit_lookup_queue(Bus *bus, Service *svc, enum bus_lookup lookup)
+{
+    svc->lookups |= lookup;
+
+    if (!svc->lookups || svc->queued || svc->state_slot)
+        return;
+
+    svc->queued = true;
+    TAILQ_INSERT_TAIL(&bus->pending, svc, q);
+}
+
+/**
+ * Callback which receives the reply of an asynchronous property lookup.
+ *
+ * The property is merged into the service record and the row redrawn if it
+ * changed. Once the reply is handled, the unit is queued again for any other
+ * lookup it still waits for and the next queued lookup is dispatched.
+ *
+ * @param reply The D-Bus message containing the property variant.
+ * @param data A pointer to the Service struct the lookup was issued for.
+ * @param err An error object, if an error occurred.
+ * @return 0 on success.
+ */
+static int bus_unit_lookup_reply(sd_bus_message *reply, void *data, sd_bus_error *err)
+{
+    Service *svc = (Service *)data;
+    Bus *bus = svc->bus;
+    const char *unit_file_state = NULL;
+    int rc;
+
+    svc->state_slot = sd_bus_slot_unref(svc->state_slot);
+    bus->inflight--;
+
+    /* The unit may have vanished in the meantime, this is not fatal */
+    if (sd_bus_message_is_method_error(reply, NULL))
+        goto fin;
+
+    rc = sd_bus_message_read(reply, "s", &unit_file_state);
+    if (rc < 0)
+        sm_err_set("Cannot read unit file state: %s\n", strerror(-rc));
+
+    unit_file_state = sm_atom(unit_file_state);
+    if (svc->unit_file_state != unit_file_state) {
+        svc->unit_file_state = unit_file_state;
+
+        /* Only rows currently on the screen need to be painted */
+        if (display_service_row(svc) > -1)
+            display_schedule_redraw();
     }
-    else
-        memcpy(result, &data, sz);
 
-    sd_bus_message_unref(reply);
+fin:
+    sd_bus_error_free(err);
+    bus_unit_lookup_queue(bus, svc, 0);
+    bus_unit_lookup_pump(bus);
+    return 0;
+}
+
+/* Dispatch queued property lookups until the in-flight limit is reached */
+static void bus_unit_lookup_pump(Bus *bus)
+{
+    Service *svc = NULL;
+    int rc;
+
+    while (bus->inflight < BUS_MAX_INFLIGHT && !TAILQ_EMPTY(&bus->pending)) {
+        svc = TAILQ_FIRST(&bus->pending);
+        TAILQ_REMOVE(&bus->pending, svc, q);
+        svc->queued = false;
+
+        /* One property at a time, the unit is queued again for the others */
+        svc->lookups &= svc->lookups - 1;
+
+        /* The manager reads the unit file state from disk, the UnitFileState
+         * property may lag behind an operation on the unit file */
+        sm_stats_call("GetUnitFileState");
+        rc = sd_bus_call_method_async(bus->bus,
+                                      &svc->state_slot,
+                                      SD_DESTINATION,
+                                      SD_OPATH,
+                                      SD_IFACE("Manager"),
+                                      "GetUnitFileState",
+                                      bus_unit_lookup_reply,
+                                      (void *)svc,
+                                      "s",
+                                      svc->unit);
+        if (rc < 0)
+            sm_err_set("Cannot request unit property: %s\n", strerror(-rc));
+
+        bus->inflight++;
+    }
+}
+
+/**
+ * Drops any outstanding property lookup for a service.
+ *
+ * Must be called before a service is freed, so that no reply is delivered
+ * to a record that no longer exists.
+ *
+ * @param bus The bus the service belongs to.
+ * @param svc The service to cancel the lookups for.
+ */
+void bus_unit_lookup_cancel(Bus *bus, Service *svc)
+{
+    if (svc->queued) {
+        TAILQ_REMOVE(&bus->pending, svc, q);
+        svc->queued = false;
+    }
+
+    if (svc->state_slot) {
+        svc->state_slot = sd_bus_slot_unref(svc->state_slot);
+        bus->inflight--;
+    }
+
+    svc->lookups = 0;
+}
+
+/**
+ * Indexes the reply of ListUnitFiles by unit name.
+ *
+ * The keys and values point into the message, which must be kept referenced
+ * for as long as the table is in use.
+ *
+ * @param reply The reply of ListUnitFiles.
+ * @param files The table to fill with unit name to unit file state entries.
+ * @return 0 on success, or a negative error code on failure.
+ */
+static int bus_read_unit_files(sd_bus_message *reply, sm_hash *files)
+{
+    const char *path, *unit_file_state, *name;
+    int rc = 0;
+
+    rc = sd_bus_message_enter_container(reply, 'a', "(ss)");
+    if (rc < 0) {
+        sm_err_set("Cannot enter into array fetching all unit files: %s", strerror(-rc));
+        return rc;
+    }
+
+    while ((rc = sd_bus_message_read(reply, "(ss)", &path, &unit_file_state)) > 0) {
+        /* Files are reported by path, units are known by the file name */
+        name = strrchr(path, '/');
+        name = name ? name + 1 : path;
+
+        /* The first path wins, just like it does in the unit search path */
+        if (!sm_hash_get(files, name))
+            sm_hash_put(files, name, (void *)unit_file_state);
+    }
+    if (rc < 0) {
+        sm_err_set("Cannot read unit file from list: %s", strerror(-rc));
+        return rc;
+    }
+
+    return sd_bus_message_exit_container(reply);
+}
+
+/**
+ * Fetches the state of every unit file known to the manager in one call.
+ *
+ * @param st The bus to query.
+ * @param files The table to fill, see bus_read_unit_files().
+ * @param reply Receives the message the table points into.
+ * @return 0 on success, or a negative error code on failure.
+ */
+static int bus_list_unit_files(struct bus_state *st, sm_hash *files, sd_bus_message **reply)
+{
+    sd_bus_error error = SD_BUS_ERROR_NULL;
+    int rc = 0;
+
+    sm_stats_call("ListUnitFiles");
+    rc = sd_bus_call_method(st->bus,
+                           SD_DESTINATION,
+                           SD_OPATH,
+                           SD_IFACE("Manager"),
+                           "ListUnitFiles",
+                           &error,
+                           reply,
+                           NULL);
+    if (rc < 0) {
+        sm_err_set("Cannot call DBUS request to fetch all unit files: %s", strerror(-rc));
+        goto fin;
+    }
+
+    if (sd_bus_error_is_set(&error)) {
+        sm_err_set("Error retrieving unit file list from DBUS: %s", error.message);
+        rc = -1;
+        goto fin;
+    }
+
+    rc = bus_read_unit_files(*reply, files);
+
+fin:
     sd_bus_error_free(&error);
     return rc;
 }
 
-static int bus_update_service_entry(sd_bus_message *reply, struct bus_state *st, uint64_t now)
+static int bus_update_service_entry(sd_bus_message *reply, struct bus_state *st, sm_hash *files, uint64_t now)
 {
 
     Service *svc = NULL;
     int rc = 0;
     bool is_new = false;
-    const char *unit, *load, *active, *sub, *description, *object; 
-    char unit_file_state[32] = {0};;
+    const char *unit, *load, *active, *sub, *description, *object, *unit_file_state;
 
     rc = sd_bus_message_read(reply, "(ssssssouso)",
                              &unit,
@@ -218,249 +668,1038 @@ static int bus_update_service_entry(sd_bus_message *reply, struct bus_state *st,
     svc = service_get_name(st, unit);
     if (!svc) {
        is_new = true;
-       svc = service_init(unit);
+       svc = service_init(st, unit);
     }
 
     if (!svc)
         sm_err_set("Failed to acquire a service entry: %s", strerror(errno));
 
     svc->last_update = now;
-    bus_unit_property(st, object, SD_IFACE("Unit"), "UnitFileState", "s", unit_file_state, 32);
+
+    /* Join against the unit file list. Units without a file have no state, instances
+     * of templates are usually only listed by their template and are looked up one by one.
+     * Without a list, as for units the manager announced, known states are kept. */
+    unit_file_state = files ? sm_hash_get(files, unit) : NULL;
+    if (files && !unit_file_state && !strchr(unit, '@'))
+        unit_file_state = "";
+
+    /* States come from a small set, as atoms a change is a pointer compare */
+    load = sm_atom(load);
+    active = sm_atom(active);
+    sub = sm_atom(sub);
+    if (unit_file_state)
+        unit_file_state = sm_atom(unit_file_state);
 
     /* Properties we detect for changes */
-    if (!svc->load || strcmp(svc->load, load))
+    if (svc->load != load)
         svc->changed++;
-    if (!svc->active || strcmp(svc->active, active))
+    if (svc->active != active)
         svc->changed++;
-    if (!svc->sub || strcmp(svc->sub, sub))
+    if (svc->sub != sub)
         svc->changed++;
-    if (!svc->unit_file_state || strcmp(svc->unit_file_state, unit_file_state))
+    if (unit_file_state && svc->unit_file_state != unit_file_state)
         svc->changed++;
 
     /* Properties we just update, but dont indicate change */
-    BUS_CPY_PROPERTY(svc, unit);
-    BUS_CPY_PROPERTY(svc, load);
-    BUS_CPY_PROPERTY(svc, active);
-    BUS_CPY_PROPERTY(svc, sub);
-    BUS_CPY_PROPERTY(svc, description);
-    BUS_CPY_PROPERTY(svc, object);
-    BUS_CPY_PROPERTY(svc, unit_file_state);
+    svc->load = load;
+    svc->active = active;
+    svc->sub = sub;
+
+    /* The search matches the description, its key is built again when it changes */
+    if (!svc->description || strcmp(svc->description, description)) {
+        service_set_description(st, svc, description);
+        if (!is_new)
+            service_set_search_key(st, svc);
+    }
 
-    if (svc->changed) {
-        display_redraw_row(svc);
-        svc->changed = 0;
+    /* The unit name and object path key the lookup indexes, so they are set only once */
+    if (is_new)
+        svc->object = sm_arena_strdup(&st->strings, object);
+    if (unit_file_state)
+        svc->unit_file_state = unit_file_state;
+
+    /* A known unit whose state moved is redrawn if it is on the screen */
+    if (svc->changed && !is_new) {
+        if (display_service_row(svc) > -1)
+            display_schedule_redraw();
+        display_status_refresh(svc);
     }
+    svc->changed = 0;
 
     if (!is_new) {
+        /* Any state missing from the join is fetched asynchronously and merged in later */
+        if (!unit_file_state && files)
+            bus_unit_lookup_queue(st, svc, LOOKUP_FILE_STATE);
         rc = 1;
         goto fin;
     }
 
-    /* Register interest in events on this object */
-    rc = sd_bus_match_signal(st->bus,
-                             &svc->slot,
-                             SD_DESTINATION,
-                             object,
-                            "org.freedesktop.DBus.Properties",
-                            "PropertiesChanged",
-                             bus_unit_changed,
-                            (void *)svc);
-     if (rc < 0) 
-         sm_err_set("Cannot register interest changed units: %s\n", strerror(-rc));
-
-     //bus_update_unit_file_state(st, svc);
-     service_insert(st, svc);
-     rc = 1;
+    service_insert(st, svc);
+    if (!unit_file_state)
+        bus_unit_lookup_queue(st, svc, LOOKUP_FILE_STATE);
+    rc = 1;
 
 fin:
     return rc;
 }
 
-static int bus_get_all_systemd_services(struct bus_state *st) {
-    sd_bus_error error = SD_BUS_ERROR_NULL;
-    sd_bus_message *reply = NULL;
-    int rc = 0;
+/**
+ * Joins the unit list with the unit file list, once both replies are in.
+ *
+ * New units are added, known ones updated and those no longer listed
+ * dropped. The screen is redrawn if the bus is the one shown.
+ *
+ * @param st The bus which was enumerated.
+ */
+static void bus_enumerated(struct bus_state *st)
+{
+    sm_hash files = {0};
     uint64_t now = service_now();
+    int rc;
 
-    sd_bus_ref(st->bus);
-
-    rc = sd_bus_call_method(st->bus,
-                           SD_DESTINATION,
-                           SD_OPATH,
-                           SD_IFACE("Manager"),
-                           "ListUnits",
-                           &error,
-                           &reply,
-                           NULL);
-    if (rc < 0) {
-        sm_err_set("Cannot call DBUS request to fetch all units: %s", strerror(-rc));
-        goto fin;
-    }
+    if (st->files_slot || st->units_slot)
+        return;
 
-    if (sd_bus_error_is_set(&error)) {
-        sm_err_set("Error retrieving unit list from DBUS: %s", error.message);
-        rc = -1;
+    /* Unit file states for every unit come in bulk and are joined by name */
+    rc = bus_read_unit_files(st->files_reply, &files);
+    if (rc < 0)
         goto fin;
-    }
 
-    rc = sd_bus_message_enter_container(reply, 'a', "(ssssssouso)");
+    rc = sd_bus_message_enter_container(st->units_reply, 'a', "(ssssssouso)");
     if (rc < 0) {
         sm_err_set("Cannot enter into array fetching all units: %s", strerror(-rc));
         goto fin;
     }
 
     while (true) {
-        rc = bus_update_service_entry(reply, st, now);
+        rc = bus_update_service_entry(st->units_reply, st, &files, now);
         if (rc <= 0)
             break;
     }
-    sd_bus_message_exit_container(reply);
+    sd_bus_message_exit_container(st->units_reply);
 
     services_prune_dead_units(st, now);
+    bus_unit_lookup_pump(st);
+
+    if (st == bus_currently_displayed())
+        display_schedule_redraw();
 
 fin:
-    sd_bus_message_unref(reply);
-    sd_bus_unref(st->bus);
-    return rc;
+    sm_hash_free(&files);
+    st->files_reply = sd_bus_message_unref(st->files_reply);
+    st->units_reply = sd_bus_message_unref(st->units_reply);
 }
 
-/* Callback which is invoked when a reload event is captured */
-static int bus_systemd_reloaded(sd_bus_message *reply, void *data, sd_bus_error *err)
+/* Callback which receives the reply of ListUnitFiles */
+static int bus_unit_files_listed(sd_bus_message *reply, void *data, sd_bus_error *err)
 {
-    /* This line here is a bug. Reload should be tracked in the services list */
-    int  rc;
     struct bus_state *st = (struct bus_state *)data;
 
-    if (sd_bus_error_is_set(err)) {
-        sm_err_set("Remove unit callback failed: %s\n", err->message);
-        return -1;
-    }
+    (void)err;
 
-    rc = sd_bus_message_read(reply, "b", &st->reloading);
-    if (rc < 0) {
-        sm_err_set("Cannot read dbus mesasge: %s\n", strerror(-rc));
-        return -1;
-    }
+    st->files_slot = sd_bus_slot_unref(st->files_slot);
+    if (sd_bus_message_is_method_error(reply, NULL))
+        sm_err_set("Error retrieving unit file list from DBUS: %s", sd_bus_message_get_error(reply)->message);
 
-    /* Reload daemon services for specific bus type and conditionally redraw screen) */
-    /* The reload emits a boolean if it starts set to true, once the reload finishes
-     * the callback emits again, with the boolean set to false */
-    if (st->reloading)
-        goto fin;
+    st->files_reply = sd_bus_message_ref(reply);
+    bus_enumerated(st);
+    return 0;
+}
 
-    
-    rc = bus_get_all_systemd_services(st);
-    if (rc < 0)
-        sm_err_set("Cannot reload system units: %s\n", strerror(-rc));
+/* Callback which receives the reply of ListUnits */
+static int bus_units_listed(sd_bus_message *reply, void *data, sd_bus_error *err)
+{
+    struct bus_state *st = (struct bus_state *)data;
 
-    /* If the affected bus is the one being shown */
-    if (((st->type == SYSTEM) && display_bus_type() == SYSTEM)
-    || ((st->type != SYSTEM) && display_bus_type() != SYSTEM))
-        display_redraw(st);
+    (void)err;
 
-fin:
-    sd_bus_error_free(err);
+    st->units_slot = sd_bus_slot_unref(st->units_slot);
+    if (sd_bus_message_is_method_error(reply, NULL))
+        sm_err_set("Error retrieving unit list from DBUS: %s", sd_bus_message_get_error(reply)->message);
+
+    st->units_reply = sd_bus_message_ref(reply);
+    bus_enumerated(st);
     return 0;
 }
 
-
-static int bus_setup_bus(struct bus_state *st)
-{
+/**
+ * Lists the units of a bus and their unit file states.
+ *
+ * Both calls are sent at once and answered asynchronously, the buses are
+ * enumerated side by side. An enumeration still in flight is dropped, its
+ * replies would be stale.
+ *
+ * @param st The bus to enumerate.
+ */
+static void bus_enumerate(struct bus_state *st)
+{
+    int rc;
+
+    st->files_slot = sd_bus_slot_unref(st->files_slot);
+    st->units_slot = sd_bus_slot_unref(st->units_slot);
+    st->files_reply = sd_bus_message_unref(st->files_reply);
+    st->units_reply = sd_bus_message_unref(st->units_reply);
+
+    sm_stats_call("ListUnitFiles");
+    rc = sd_bus_call_method_async(st->bus,
+                                  &st->files_slot,
+                                  SD_DESTINATION,
+                                  SD_OPATH,
+                                  SD_IFACE("Manager"),
+                                  "ListUnitFiles",
+                                  bus_unit_files_listed,
+                                  (void *)st,
+                                  NULL);
+    if (rc < 0)
+        sm_err_set("Cannot call DBUS request to fetch all unit files: %s", strerror(-rc));
+
+    sm_stats_call("ListUnits");
+    rc = sd_bus_call_method_async(st->bus,
+                                  &st->units_slot,
+                                  SD_DESTINATION,
+                                  SD_OPATH,
+                                  SD_IFACE("Manager"),
+                                  "ListUnits",
+                                  bus_units_listed,
+                                  (void *)st,
+                                  NULL);
+    if (rc < 0)
+        sm_err_set("Cannot call DBUS request to fetch all units: %s", strerror(-rc));
+}
+
+/**
+ * Handles the messages of a bus until its units are enumerated. Messages of
+ * the other bus are left for the event loop.
+ *
+ * @param st The bus to wait for.
+ */
+static void bus_wait_enumerated(Bus *st)
+{
+    int rc;
+
+    while (st->files_slot || st->units_slot) {
+        rc = sd_bus_process(st->bus, NULL);
+        if (rc < 0)
+            sm_err_set("Cannot process messages: %s\n", strerror(-rc));
+        if (rc > 0)
+            continue;
+
+        rc = sd_bus_wait(st->bus, UINT64_MAX);
+        if (rc < 0)
+            sm_err_set("Cannot wait for messages: %s\n", strerror(-rc));
+    }
+}
+
+/* Units of a dump waiting for their unit file state, which ListUnitFiles did not have */
+struct bus_dump {
+    bus_unit_cb cb;
+    void *data;
+    int inflight;
+};
+
+struct bus_dump_lookup {
+    struct bus_dump *dump;
+    struct bus_unit u;
+};
+
+static void bus_dump_lookup_free(struct bus_dump_lookup *l)
+{
+    free((char *)l->u.unit);
+    free((char *)l->u.description);
+    free((char *)l->u.load);
+    free((char *)l->u.active);
+    free((char *)l->u.sub);
+    free((char *)l->u.object);
+    free(l);
+}
+
+/* Callback which completes a dumped unit with its unit file state */
+static int bus_dump_lookup_reply(sd_bus_message *reply, void *data, sd_bus_error *err)
+{
+    struct bus_dump_lookup *l = (struct bus_dump_lookup *)data;
+    int rc;
+
+    (void)err;
+
+    l->dump->inflight--;
+
+    /* Units without a unit file have no state */
+    l->u.unit_file_state = "";
+    if (!sd_bus_message_is_method_error(reply, NULL)) {
+        rc = sd_bus_message_read(reply, "s", &l->u.unit_file_state);
+        if (rc < 0)
+            sm_err_set("Cannot read unit file state: %s\n", strerror(-rc));
+    }
+
+    l->dump->cb(&l->u, l->dump->data);
+    bus_dump_lookup_free(l);
+    return 0;
+}
+
+/* Process replies of a dump until fewer than max lookups are in flight */
+static void bus_dump_wait(sd_bus *bus, struct bus_dump *dump, int max)
+{
+    int rc;
+
+    while (dump->inflight > max) {
+        rc = sd_bus_process(bus, NULL);
+        if (rc < 0)
+            sm_err_set("Cannot process unit file states: %s\n", strerror(-rc));
+        if (rc > 0)
+            continue;
+
+        rc = sd_bus_wait(bus, UINT64_MAX);
+        if (rc < 0)
+            sm_err_set("Cannot wait for unit file states: %s\n", strerror(-rc));
+    }
+}
+
+/**
+ * Lists the units of a bus without keeping any records of them.
+ *
+ * The unit file states come in bulk and are joined by name, as in
+ * bus_enumerated(). Each unit is handed to the callback as it
+ * is read from the reply. The few units the join misses, usually template
+ * instances, are looked up with pipelined calls and handed over as their
+ * replies arrive, after the others.
+ *
+ * @param type The bus to list.
+ * @param cb Called with every unit, its strings are only valid during the call.
+ * @param data Passed on to cb.
+ * @return 0 on success, -ENOMEDIUM if there is no user bus to list.
+ */
+int bus_dump_units(enum bus_type type, bus_unit_cb cb, void *data)
+{
     sd_bus_error error = SD_BUS_ERROR_NULL;
+    sd_bus_message *reply = NULL, *files_reply = NULL;
+    struct bus_state st = { .type = type };
+    struct bus_dump dump = { .cb = cb, .data = data };
+    struct bus_dump_lookup *l = NULL;
+    struct bus_unit u = { .type = type };
+    sm_hash files = {0};
+    int rc;
+
+    if (type == SYSTEM)
+        rc = sd_bus_open_system(&st.bus);
+    else
+        rc = sd_bus_open_user(&st.bus);
+    if (-rc == ENOMEDIUM)
+        return rc;
+    if (rc < 0)
+        sm_err_set("Cannot initialize DBUS: %s\n", strerror(-rc));
+
+    rc = bus_list_unit_files(&st, &files, &files_reply);
+    if (rc < 0)
+        goto fin;
+
+    rc = sd_bus_call_method(st.bus,
+                           SD_DESTINATION,
+                           SD_OPATH,
+                           SD_IFACE("Manager"),
+                           "ListUnits",
+                           &error,
+                           &reply,
+                           NULL);
+    if (rc < 0)
+        sm_err_set("Cannot call DBUS request to fetch all units: %s", strerror(-rc));
+
+    if (sd_bus_error_is_set(&error))
+        sm_err_set("Error retrieving unit list from DBUS: %s", error.message);
+
+    rc = sd_bus_message_enter_container(reply, 'a', "(ssssssouso)");
+    if (rc < 0)
+        sm_err_set("Cannot enter into array fetching all units: %s", strerror(-rc));
+
+    while ((rc = sd_bus_message_read(reply, "(ssssssouso)",
+                                     &u.unit,
+                                     &u.description,
+                                     &u.load,
+                                     &u.active,
+                                     &u.sub,
+                                     NULL,
+                                     &u.object,
+                                     NULL,
+                                     NULL,
+                                     NULL)) > 0) {
+        u.unit_file_state = sm_hash_get(&files, u.unit);
+        if (!u.unit_file_state && !strchr(u.unit, '@'))
+            u.unit_file_state = "";
+
+        if (u.unit_file_state) {
+            cb(&u, data);
+            continue;
+        }
+
+        /* Stay below the limit of pending replies the bus puts on a connection */
+        bus_dump_wait(st.bus, &dump, BUS_MAX_INFLIGHT - 1);
+
+        l = calloc(1, sizeof(struct bus_dump_lookup));
+        if (!l)
+            sm_err_set("Cannot allocate unit lookup: %s\n", strerror(errno));
+
+        l->dump = &dump;
+        l->u.type = type;
+        l->u.unit = strdup(u.unit);
+        l->u.description = strdup(u.description);
+        l->u.load = strdup(u.load);
+        l->u.active = strdup(u.active);
+        l->u.sub = strdup(u.sub);
+        l->u.object = strdup(u.object);
+        if (!l->u.unit || !l->u.description || !l->u.load || !l->u.active || !l->u.sub || !l->u.object)
+            sm_err_set("Cannot allocate unit lookup: %s\n", strerror(errno));
+
+        rc = sd_bus_call_method_async(st.bus,
+                                      NULL,
+                                      SD_DESTINATION,
+                                      SD_OPATH,
+                                      SD_IFACE("Manager"),
+                                      "GetUnitFileState",
+                                      bus_dump_lookup_reply,
+                                      (void *)l,
+                                      "s",
+                                      l->u.unit);
+        if (rc < 0)
+            sm_err_set("Cannot request unit file state: %s\n", strerror(-rc));
+
+        dump.inflight++;
+    }
+    if (rc < 0)
+        sm_err_set("Cannot ready service from service list: %s", strerror(-rc));
+
+    sd_bus_message_exit_container(reply);
+    bus_dump_wait(st.bus, &dump, 0);
+
+fin:
+    sm_hash_free(&files);
+    sd_bus_error_free(&error);
+    sd_bus_message_unref(files_reply);
+    sd_bus_message_unref(reply);
+    sd_bus_flush_close_unref(st.bus);
+    return rc;
+}
+
+/* Run bus_units_flush() once the bus has no messages left to handle */
+static void bus_units_arm(struct bus_state *st)
+{
+    int rc;
+
+    rc = sd_event_source_set_enabled(st->changes, SD_EVENT_ONESHOT);
+    if (rc < 0)
+        sm_err_set("Cannot enable unit flush: %s\n", strerror(-rc));
+}
+
+/* Queue a unit announced by the manager, it is listed with the next flush */
+static void bus_units_queue(struct bus_state *st, const char *unit)
+{
+    char **units = NULL;
+
+    /* One more slot for the terminating NULL */
+    if (st->n_new_units + 1 >= st->cap_new_units) {
+        int cap = st->cap_new_units ? st->cap_new_units * 2 : 64;
+        units = realloc(st->new_units, cap * sizeof(char *));
+        if (!units)
+            sm_err_set("Cannot queue new unit: %s", strerror(errno));
+        st->new_units = units;
+        st->cap_new_units = cap;
+    }
+
+    st->new_units[st->n_new_units] = strdup(unit);
+    if (!st->new_units[st->n_new_units])
+        sm_err_set("Cannot queue new unit: %s", strerror(errno));
+    st->new_units[++st->n_new_units] = NULL;
+
+    bus_units_arm(st);
+}
+
+/* Forget a queued unit which was removed before it was listed */
+static void bus_units_unqueue(struct bus_state *st, const char *unit)
+{
+    for (int i = 0; i < st->n_new_units; i++) {
+        if (strcmp(st->new_units[i], unit))
+            continue;
+
+        free(st->new_units[i]);
+        st->new_units[i] = st->new_units[--st->n_new_units];
+        st->new_units[st->n_new_units] = NULL;
+        return;
+    }
+}
+
+/* Callback which receives the reply of ListUnitsByNames, the units are added or updated */
+static int bus_units_listed_by_names(sd_bus_message *reply, void *data, sd_bus_error *err)
+{
+    struct bus_state *st = (struct bus_state *)data;
+    uint64_t now = service_now();
+    int rc;
+
+    st->by_names_inflight--;
+
+    /* Managers older than ListUnitsByNames pick the units up on the next start */
+    if (sd_bus_message_is_method_error(reply, NULL)) {
+        sm_err_window("Cannot list new units: %s", sd_bus_message_get_error(reply)->message);
+        goto fin;
+    }
+
+    rc = sd_bus_message_enter_container(reply, 'a', "(ssssssouso)");
+    if (rc < 0)
+        sm_err_set("Cannot enter into array fetching new units: %s", strerror(-rc));
+
+    while (bus_update_service_entry(reply, st, NULL, now) > 0)
+        ;
+    sd_bus_message_exit_container(reply);
+
+    bus_unit_lookup_pump(st);
+    if (st == bus_currently_displayed())
+        display_schedule_redraw();
+
+fin:
+    /* Units announced while the call was out are listed next */
+    if (st->n_new_units)
+        bus_units_arm(st);
+
+    sd_bus_error_free(err);
+    return 0;
+}
+
+/**
+ * Applies the units announced and removed since the last flush.
+ *
+ * Removed units are dropped in a single pass over the list, the new ones are
+ * listed with one ListUnitsByNames call. Bursts of transient units cost one
+ * round trip and one sweep, rather than one of each per unit.
+ *
+ * @param s The deferred event source.
+ * @param data The bus the units belong to.
+ * @return 0 to indicate the event was handled successfully.
+ */
+static int bus_units_flush(sd_event_source *s, void *data)
+{
+    struct bus_state *st = (struct bus_state *)data;
+    sd_bus_message *m = NULL;
+    int rc;
+
+    (void)s;
+
+    /* Removed units were stamped 0, every other unit is newer than that */
+    if (st->n_removed) {
+        services_prune_dead_units(st, 1);
+        st->n_removed = 0;
+        if (st == bus_currently_displayed())
+            display_schedule_redraw();
+    }
+
+    /* One listing at a time, units announced meanwhile go with the next. A
+     * flush runs whenever the bus is idle, which may be between two signals
+     * of a burst, and the bus daemon limits the calls awaiting a reply. */
+    if (!st->n_new_units || st->by_names_inflight)
+        return 0;
+
+    rc = sd_bus_message_new_method_call(st->bus,
+                                        &m,
+                                        SD_DESTINATION,
+                                        SD_OPATH,
+                                        SD_IFACE("Manager"),
+                                        "ListUnitsByNames");
+    if (rc < 0)
+        sm_err_set("Cannot list new units: %s", strerror(-rc));
+
+    rc = sd_bus_message_append_strv(m, st->new_units);
+    if (rc < 0)
+        sm_err_set("Cannot list new units: %s", strerror(-rc));
+
+    sm_stats_call("ListUnitsByNames");
+    rc = sd_bus_call_async(st->bus, NULL, m, bus_units_listed_by_names, (void *)st, 0);
+    if (rc < 0)
+        sm_err_set("Cannot list new units: %s", strerror(-rc));
+    st->by_names_inflight++;
+
+    for (int i = 0; i < st->n_new_units; i++)
+        free(st->new_units[i]);
+    st->n_new_units = 0;
+    st->new_units[0] = NULL;
+
+    sd_bus_message_unref(m);
+    return 0;
+}
+
+/* Callback for UnitNew, units not listed yet are queued for the next flush */
+static int bus_unit_new(sd_bus_message *reply, void *data, sd_bus_error *err)
+{
+    struct bus_state *st = (struct bus_state *)data;
+    const char *unit = NULL, *object = NULL;
+    Service *svc = NULL;
+    int rc;
+
+    (void)err;
+
+    rc = sd_bus_message_read(reply, "so", &unit, &object);
+    if (rc < 0)
+        sm_err_set("Cannot read new unit: %s\n", strerror(-rc));
+
+    sm_stats_signal(true);
+
+    /* A reload announces every unit again, they are all listed once it ends */
+    if (st->reloading)
+        return 0;
+
+    /* A unit removed but not swept yet is listed again, it comes back */
+    svc = service_get_name(st, unit);
+    if (svc && svc->last_update)
+        return 0;
+
+    bus_units_queue(st, unit);
+    return 0;
+}
+
+/* Callback for UnitRemoved, the unit is dropped with the next flush */
+static int bus_unit_removed(sd_bus_message *reply, void *data, sd_bus_error *err)
+{
+    struct bus_state *st = (struct bus_state *)data;
+    const char *unit = NULL, *object = NULL;
+    Service *svc = NULL;
+    int rc;
+
+    (void)err;
+
+    rc = sd_bus_message_read(reply, "so", &unit, &object);
+    if (rc < 0)
+        sm_err_set("Cannot read removed unit: %s\n", strerror(-rc));
+
+    svc = service_get_name(st, unit);
+    sm_stats_signal(svc != NULL);
+
+    /* A reload removes every unit before it loads them again, units which
+     * are really gone are dropped by the listing once it ends */
+    if (st->reloading)
+        return 0;
+
+    bus_units_unqueue(st, unit);
+    if (!svc || !svc->last_update)
+        return 0;
+
+    svc->last_update = 0;
+    st->n_removed++;
+    bus_units_arm(st);
+    return 0;
+}
+
+/* Callback which is invoked when a reload event is captured */
+static int bus_systemd_reloaded(sd_bus_message *reply, void *data, sd_bus_error *err)
+{
+    /* This line here is a bug. Reload should be tracked in the services list */
+    int  rc;
+    struct bus_state *st = (struct bus_state *)data;
+
+    if (sd_bus_error_is_set(err)) {
+        sm_err_set("Remove unit callback failed: %s\n", err->message);
+        return -1;
+    }
+
+    rc = sd_bus_message_read(reply, "b", &st->reloading);
+    if (rc < 0) {
+        sm_err_set("Cannot read dbus mesasge: %s\n", strerror(-rc));
+        return -1;
+    }
+    sm_stats_signal(true);
+
+    /* Reload daemon services for specific bus type and conditionally redraw screen) */
+    /* The reload emits a boolean if it starts set to true, once the reload finishes
+     * the callback emits again, with the boolean set to false */
+    if (st->reloading)
+        goto fin;
+
+    /* The UnitRemoved and UnitNew signals of the reload were ignored, one
+     * listing joined with the unit files brings the states, descriptions and
+     * unit file states of every unit up to date and drops the units gone */
+    bus_enumerate(st);
+
+fin:
+    sd_bus_error_free(err);
+    return 0;
+}
+
+
+static const char *bus_str_operations[] = {
+    "StartUnit",
+    "StopUnit",
+    "RestartUnit",
+    "EnableUnitFiles",
+    "DisableUnitFiles",
+    "MaskUnitFiles",
+    "UnmaskUnitFiles",
+    "ReloadUnit"
+};
+
+/* What a job queued by an operation is shown as, by enum operation */
+static const char *bus_str_jobs[] = {
+    "start",
+    "stop",
+    "restart",
+    "enable",
+    "disable",
+    "mask",
+    "unmask",
+    "reload"
+};
+
+/* Redraw a unit whose job changed, if it is on the screen */
+static void bus_job_changed(Service *svc)
+{
+    if (display_service_row(svc) > -1)
+        display_schedule_redraw();
+}
+
+static void bus_operation_pump(Bus *bus);
+
+/**
+ * Callback which receives the reply of an operation on a unit.
+ *
+ * The reply names the job systemd queued, which is shown pending until
+ * JobRemoved reports how it ended. The next queued operation is sent.
+ *
+ * @param reply The D-Bus message containing the reply.
+ * @param data A pointer to the Service struct the operation was sent for.
+ * @param err An error object, if an error occurred.
+ * @return 0 on success.
+ */
+static int bus_operation_reply(sd_bus_message *reply, void *data, sd_bus_error *err)
+{
+    Service *svc = (Service *)data;
+    Bus *bus = svc->bus;
+    const char *job = NULL;
+    int rc;
+
+    (void)err;
+
+    svc->op_slot = sd_bus_slot_unref(svc->op_slot);
+    bus->op_inflight--;
+
+    if (sd_bus_message_is_method_error(reply, NULL)) {
+        sm_err_window("%s", sd_bus_message_get_error(reply)->message);
+        goto fin;
+    }
+
+    rc = sd_bus_message_read(reply, "o", &job);
+    if (rc < 0)
+        sm_err_set("Cannot read job of operation %s: %s\n", bus_str_operations[svc->op], strerror(-rc));
+
+    /* JobNew may have been seen first */
+    if (svc->job && strcmp(svc->job, job) == 0)
+        goto fin;
+
+    BUS_CPY_PROPERTY(svc, job);
+    svc->job_type = bus_str_jobs[svc->op];
+    free(svc->job_result);
+    svc->job_result = NULL;
+    bus_job_changed(svc);
+
+fin:
+    bus_operation_pump(bus);
+    return 0;
+}
+
+/* Free a NULL terminated list of strings */
+static void bus_strv_free(char **strv)
+{
+    for (char **s = strv; *s; s++)
+        free(*s);
+    free(strv);
+}
+
+/**
+ * Callback which receives the reply of a unit file operation.
+ *
+ * The unit file state of every unit in the call is looked up again. The units
+ * are found by name, some may have been removed while the call was pending.
+ *
+ * @param reply The D-Bus message containing the reply.
+ * @param data The struct bus_unit_files the call was sent with, freed here.
+ * @param err An error object, if an error occurred.
+ * @return 0 on success.
+ */
+static int bus_unit_files_reply(sd_bus_message *reply, void *data, sd_bus_error *err)
+{
+    struct bus_unit_files *call = (struct bus_unit_files *)data;
+    Service *svc = NULL;
+
+    (void)err;
+
+    if (sd_bus_message_is_method_error(reply, NULL))
+        sm_err_window("%s", sd_bus_message_get_error(reply)->message);
+
+    for (char **unit = call->units; *unit; unit++) {
+        svc = service_get_name(call->bus, *unit);
+        if (svc)
+            bus_unit_lookup_queue(call->bus, svc, LOOKUP_FILE_STATE);
+    }
+    bus_unit_lookup_pump(call->bus);
+
+    bus_strv_free(call->units);
+    free(call);
+    return 0;
+}
+
+/* Callback for JobNew, shows jobs of the units as pending, whoever queued them */
+static int bus_job_new(sd_bus_message *reply, void *data, sd_bus_error *err)
+{
+    Bus *bus = (Bus *)data;
+    const char *job = NULL, *unit = NULL;
+    Service *svc = NULL;
+    uint32_t id;
+    int rc;
+
+    (void)err;
+
+    rc = sd_bus_message_read(reply, "uos", &id, &job, &unit);
+    if (rc < 0)
+        sm_err_set("Cannot read new job: %s\n", strerror(-rc));
+
+    svc = service_get_name(bus, unit);
+    sm_stats_signal(svc != NULL);
+    if (!svc || svc->job)
+        return 0;
+
+    BUS_CPY_PROPERTY(svc, job);
+    svc->job_type = svc->op_slot ? bus_str_jobs[svc->op] : "job";
+    free(svc->job_result);
+    svc->job_result = NULL;
+    bus_job_changed(svc);
+    return 0;
+}
+
+/* Callback for JobRemoved, keeps the result of the job that was shown pending */
+static int bus_job_removed(sd_bus_message *reply, void *data, sd_bus_error *err)
+{
+    Bus *bus = (Bus *)data;
+    const char *job = NULL, *unit = NULL, *job_result = NULL;
+    Service *svc = NULL;
+    uint32_t id;
+    int rc;
+
+    (void)err;
+
+    rc = sd_bus_message_read(reply, "uoss", &id, &job, &unit, &job_result);
+    if (rc < 0)
+        sm_err_set("Cannot read removed job: %s\n", strerror(-rc));
+
+    svc = service_get_name(bus, unit);
+    sm_stats_signal(svc != NULL);
+    if (!svc || !svc->job || strcmp(svc->job, job))
+        return 0;
+
+    free(svc->job);
+    svc->job = NULL;
+    BUS_CPY_PROPERTY(svc, job_result);
+    bus_job_changed(svc);
+    return 0;
+}
+
+
+/* Callback for the reply of Subscribe and of the signal matches, without them the list would go stale */
+static int bus_subscribed(sd_bus_message *reply, void *data, sd_bus_error *err)
+{
+    (void)data;
+    (void)err;
+
+    if (sd_bus_message_is_method_error(reply, NULL))
+        sm_err_set("Cannot subcribe to systemd dbus events: %s\n", sd_bus_message_get_error(reply)->message);
+
+    return 0;
+}
+
+/**
+ * Subscribes to the signals of the manager of a bus.
+ *
+ * Nothing here waits for a reply, the calls go out in order ahead of the
+ * enumeration, so no change after it is missed.
+ *
+ * @param st The bus to subscribe on.
+ * @return 0 on success, or a negative error code on failure.
+ */
+static int bus_setup_bus(struct bus_state *st)
+{
     int rc = 0;
 
-    /* Now subscribe to events in systemd */
-    rc = sd_bus_call_method(st->bus,
+    /* One match covers property changes of every unit, signals are routed to
+     * the right service by their object path */
+    rc = sd_bus_add_match_async(st->bus,
+            NULL,
+            "type='signal',"
+            "sender='" SD_DESTINATION "',"
+            "interface='org.freedesktop.DBus.Properties',"
+            "member='PropertiesChanged',"
+            "path_namespace='" SD_UNIT_OPATH "'",
+            bus_unit_changed,
+            bus_subscribed,
+            (void *)st);
+    if (rc < 0) {
+        sm_err_set("Cannot register interest changed units: %s\n", strerror(-rc));
+        return rc;
+    }
+
+    /* We care about the reloading signal/event */
+    rc = sd_bus_match_signal_async(st->bus,
+            NULL,
             SD_DESTINATION,
             SD_OPATH,
             SD_IFACE("Manager"),
-            "Subscribe",
-            &error,
+            "Reloading",
+            bus_systemd_reloaded,
+            bus_subscribed,
+            (void *)st);
+    if (rc < 0) {
+        sm_err_set("Cannot register interest in daemon reloads: %s\n", strerror(-rc));
+        return rc;
+    }
+
+    /* Units are added and removed as the manager loads and unloads them */
+    rc = sd_bus_match_signal_async(st->bus,
             NULL,
-            NULL);
+            SD_DESTINATION,
+            SD_OPATH,
+            SD_IFACE("Manager"),
+            "UnitNew",
+            bus_unit_new,
+            bus_subscribed,
+            (void *)st);
     if (rc < 0) {
-        sm_err_set("Cannot subcribe to systemd dbus events: %s\n", strerror(-rc));
-        goto fin;
+        sm_err_set("Cannot register interest in new units: %s\n", strerror(-rc));
+        return rc;
     }
 
-    if (sd_bus_error_is_set(&error)) {
-        sm_err_set("Cannot subcribe to systemd dbus events: %s\n", error.message);
-        goto fin;
+    rc = sd_bus_match_signal_async(st->bus,
+            NULL,
+            SD_DESTINATION,
+            SD_OPATH,
+            SD_IFACE("Manager"),
+            "UnitRemoved",
+            bus_unit_removed,
+            bus_subscribed,
+            (void *)st);
+    if (rc < 0) {
+        sm_err_set("Cannot register interest in removed units: %s\n", strerror(-rc));
+        return rc;
     }
 
-    /* We care about the reloading signal/event */
-    rc = sd_bus_match_signal(st->bus, 
+    /* Jobs are shown on their unit while they run */
+    rc = sd_bus_match_signal_async(st->bus,
             NULL,
             SD_DESTINATION,
             SD_OPATH,
             SD_IFACE("Manager"),
-            "Reloading",
-            bus_systemd_reloaded,
+            "JobNew",
+            bus_job_new,
+            bus_subscribed,
             (void *)st);
     if (rc < 0) {
-        sm_err_set("Cannot register interest in daemon reloads: %s\n", strerror(-rc));
-        goto fin;
+        sm_err_set("Cannot register interest in new jobs: %s\n", strerror(-rc));
+        return rc;
     }
 
-fin:
-    sd_bus_error_free(&error);
-    return rc;
-}
+    rc = sd_bus_match_signal_async(st->bus,
+            NULL,
+            SD_DESTINATION,
+            SD_OPATH,
+            SD_IFACE("Manager"),
+            "JobRemoved",
+            bus_job_removed,
+            bus_subscribed,
+            (void *)st);
+    if (rc < 0) {
+        sm_err_set("Cannot register interest in removed jobs: %s\n", strerror(-rc));
+        return rc;
+    }
+
+    /* Now subscribe to events in systemd */
+    sm_stats_call("Subscribe");
+    rc = sd_bus_call_method_async(st->bus,
+            NULL,
+            SD_DESTINATION,
+            SD_OPATH,
+            SD_IFACE("Manager"),
+            "Subscribe",
+            bus_subscribed,
+            (void *)st,
+            NULL);
+    if (rc < 0) {
+        sm_err_set("Cannot subcribe to systemd dbus events: %s\n", strerror(-rc));
+        return rc;
+    }
 
+    bus_enumerate(st);
+    return 0;
+}
 
 /**
- * Retrieves the unit file state for the given service.
+ * Connects a bus, subscribes to its manager and starts enumerating its units.
  *
- * This function uses the systemd D-Bus API to fetch the current state of the
- * unit file associated with the provided service. The state is stored in the
- * `unit_file_state` field of the `Service` struct.
- *
- * @param svc The service to retrieve the unit file state for.
- * @param is_system Indicates whether the service is a system service (true) or a user service (false).
+ * @param st The bus to set up.
+ * @param type SYSTEM or USER.
+ * @param ev The event loop the bus is attached to.
+ * @return 0 on success, -ENOMEDIUM if there is no user bus, or another
+ *         negative error code on failure.
  */
-void bus_update_unit_file_state(Bus *bus, Service *svc)
+static int bus_connect(struct bus_state *st, enum bus_type type, sd_event *ev)
 {
-    sd_bus_error error = SD_BUS_ERROR_NULL;
-    sd_bus_message *reply = NULL;
-    const char *unit_file_state = NULL;
     int rc;
 
-    sd_bus_ref(bus->bus);
-    rc = sd_bus_call_method(bus->bus,
-                            SD_DESTINATION,
-                            SD_OPATH,
-                            SD_IFACE("Manager"),
-                            "GetUnitFileState",
-                            &error,
-                            &reply,
-                            "s",
-                            svc->unit);
-    if (-rc == ENOENT || -rc == ENOLINK)
-        goto fin;
+    if (type == SYSTEM)
+        rc = sd_bus_default_system(&st->bus);
+    else
+        rc = sd_bus_default_user(&st->bus);
+    if (-rc == ENOMEDIUM)
+        return rc;
+    if (rc < 0) {
+        sm_err_set("Cannot initialize DBUS: %s\n", strerror(-rc));
+        return rc;
+    }
 
-    if (rc < 0)
-        sm_err_set("Cannot send dbus message to get unit state for %s: %s\n", svc->unit, strerror(-rc));
+    st->type = type;
+    sm_pool_init(&st->records, sizeof(Service));
+    TAILQ_INIT(&st->services);
+    TAILQ_INIT(&st->pending);
+    TAILQ_INIT(&st->operations);
 
-    if (sd_bus_error_is_set(&error))
-        sm_err_set("Bad reply to unit file state: %s\n", error.message);
+    rc = sd_bus_attach_event(st->bus, ev, SD_EVENT_PRIORITY_NORMAL);
+    if (rc < 0) {
+        sm_err_set("Unable to attach bus to event loop: %s\n", strerror(-rc));
+        return rc;
+    }
 
-    rc = sd_bus_message_read(reply, "s", &unit_file_state);
-    if (rc < 0)
-        sm_err_set("Bad response reading message reply: %s\n", strerror(-rc));
+    /* Units announced and removed are applied once the bus goes idle, it stays off until then */
+    rc = sd_event_add_defer(ev, &st->changes, bus_units_flush, (void *)st);
+    if (rc < 0) {
+        sm_err_set("Cannot initialize unit flush: %s\n", strerror(-rc));
+        return rc;
+    }
 
-    BUS_CPY_PROPERTY(svc, unit_file_state);
+    rc = sd_event_source_set_priority(st->changes, SD_EVENT_PRIORITY_IDLE);
+    if (rc < 0) {
+        sm_err_set("Cannot initialize unit flush: %s\n", strerror(-rc));
+        return rc;
+    }
 
-fin:
-    sd_bus_unref(bus->bus);
-    sd_bus_message_unref(reply);
-    sd_bus_error_free(&error);
+    rc = sd_event_source_set_enabled(st->changes, SD_EVENT_OFF);
+    if (rc < 0) {
+        sm_err_set("Cannot initialize unit flush: %s\n", strerror(-rc));
+        return rc;
+    }
+
+    return bus_setup_bus(st);
 }
 
+/**
+ * Connects to the system bus and, if there is one, the user bus.
+ *
+ * Both buses are enumerated side by side. This only waits for the bus that
+ * is shown, the other one is filled in by the event loop in the background.
+ *
+ * @return 0 on success, or a negative error code on failure.
+ */
 int bus_init(void)
 {
     int rc = 0;
     sd_event *ev = NULL;
-    Bus *user = &state[USER], *sys = &state[SYSTEM];
 
     rc = sd_event_default(&ev);
     if (rc < 0) {
@@ -469,63 +1708,23 @@ int bus_init(void)
     }
 
     /* Do the system-wide systemd instance */
-    rc = sd_bus_default_system(&sys->bus);
-    if (rc < 0) {
-        sm_err_set("Cannot initialize DBUS: %s\n", strerror(-rc));
-        goto fin;
-    }
-
-    sys->type = SYSTEM;
-    TAILQ_INIT(&sys->services);
-    rc = bus_setup_bus(sys);
-    if (rc < 0)
-        goto fin;
-    sd_bus_ref(sys->bus);
-
-    rc = sd_bus_attach_event(sys->bus, ev, SD_EVENT_PRIORITY_NORMAL);
-    if (rc < 0) {
-        sm_err_set("Unable to attach bus to event loop: %s\n", strerror(-rc));
-        goto fin;
-    }
-
-    rc = bus_get_all_systemd_services(sys);
+    rc = bus_connect(&state[SYSTEM], SYSTEM, ev);
     if (rc < 0)
         goto fin;
 
     /* Optionally do the user systemd instance */
-    rc = sd_bus_default_user(&user->bus);
-    if (-rc == ENOMEDIUM) {
-        system_only = true;
+    rc = bus_connect(&state[USER], USER, ev);
+    system_only = -rc == ENOMEDIUM;
+    if (system_only)
         rc = 0;
-        goto fin;
-    }
-    else if (rc < 0) {
-        sm_err_set("Cannot initialize DBUS: %s\n", strerror(-rc));
-        goto fin;
-    }
-
-    system_only = false;
-    user->type = USER;
-    TAILQ_INIT(&user->services);
-    rc = bus_setup_bus(user);
     if (rc < 0)
         goto fin;
-    sd_bus_ref(user->bus);
-
-    rc = sd_bus_attach_event(user->bus, ev, SD_EVENT_PRIORITY_NORMAL);
-    if (rc < 0) {
-        sm_err_set("Unable to attach bus to event loop: %s\n", strerror(-rc));
-        goto fin;
-    }
 
-    rc = bus_get_all_systemd_services(user);
-    if (rc < 0) 
-        goto fin;
+    if (bus_currently_displayed()->bus)
+        bus_wait_enumerated(bus_currently_displayed());
 
 fin:
     sd_event_unref(ev);
-    sd_bus_unref(user->bus);
-    sd_bus_unref(sys->bus);
     return rc;
 }
 
@@ -540,234 +1739,227 @@ Bus * bus_currently_displayed(void)
 }
 
 /**
- * Retrieves the invocation ID for the specified system or user service unit.
+ * Fetches the details shown in the status window of a unit.
+ *
+ * The generic unit properties and those of the type specific interface are
+ * each read with a single asynchronous GetAll call. When both replies are in,
+ * display_status_update() is called. If a fetch is still outstanding, this
+ * does nothing.
  *
  * @param bus The bus connection to use.
  * @param svc Pointer to the service structure to work on.
- * @return 0 on success, or a negative error code on failure.
  */
-int bus_invocation_id(Bus *bus, Service *svc) {
-    sd_bus_error error = SD_BUS_ERROR_NULL;
-    sd_bus_message *reply = NULL;
-    uint8_t *id = NULL;
-    size_t len = 0;
-    int rc = 0;
-    char *ptr = NULL;
-    size_t remaining = 32; /* Max length of invocation_id is 32 chars + 1 null terminator */
-
-    rc = sd_bus_get_property(bus->bus,
-                    SD_DESTINATION,
-                    svc->object,
-                    SD_IFACE("Unit"),
-                    "InvocationID",
-                    &error,
-                    &reply,
-                    "ay");
-    if (sd_bus_error_is_set(&error)) {
-        sm_err_window("Cannot fetch invocation ID: %s", error.message);
-        goto fin;
-    }
+void bus_fetch_service_status(Bus *bus, Service *svc)
+{
+    if (status_calls[0].slot || status_calls[1].slot)
+        return;
+
+    status_started = sm_stats_now();
+    bus_unit_properties_all(bus, &status_calls[0], svc, SD_IFACE("Unit"), bus_unit_properties);
+
+    if (svc->type < MAX_TYPES && bus_type_properties[svc->type].iface)
+        bus_unit_properties_all(bus,
+                                &status_calls[1],
+                                svc,
+                                bus_type_properties[svc->type].iface,
+                                bus_type_properties[svc->type].properties);
+}
 
-    if (rc < 0) {
-        sm_err_window("Cannot fetch invocation ID: %s", strerror(-rc));
-        goto fin;
+/* Drop an outstanding status fetch, its unit is no longer shown */
+void bus_fetch_service_status_cancel(void)
+{
+    for (int i = 0; i < 2; i++) {
+        status_calls[i].slot = sd_bus_slot_unref(status_calls[i].slot);
+        status_calls[i].svc = NULL;
     }
 
-    rc = sd_bus_message_read_array(reply, 'y', (const void **)&id, &len);
-    if (rc < 0) {
-        sm_err_window("Cannot fetch this invocation ID: %s", strerror(-rc));
-        goto fin;
-    }
+    free(status_error);
+    status_error = NULL;
+}
 
-    /* There is no ID */
-    if (len != 16) {
-        rc = -1;
-        strncpy(svc->invocation_id, "00000000000000000000000000000000", 33);
-        goto fin;
-    }
+/**
+ * Sends a unit file operation for many units in a single call.
+ *
+ * @param bus The bus of the units.
+ * @param units The NULL terminated unit names, owned by the call from now on.
+ * @param op One of ENABLE, DISABLE, MASK or UNMASK.
+ * @return true if the operation was sent.
+ */
+static int bus_unit_files_operation(Bus *bus, char **units, enum operation op)
+{
+    struct bus_unit_files *call = NULL;
+    sd_bus_message *m = NULL;
+    int rc = 0;
 
-    ptr = svc->invocation_id;
-    for (size_t i = 0; i < len && remaining > 0; i++) {
-        int written = snprintf(ptr, remaining + 1, "%02hhx", id[i]);
+    call = calloc(1, sizeof(struct bus_unit_files));
+    if (!call)
+        sm_err_set("Cannot send operation %s to bus: %s", bus_str_operations[op], strerror(errno));
 
-        if (written < 0) {
-            /* write error */
-            sm_err_set("Failed to write invocation ID");
-            strncpy(svc->invocation_id, "00000000000000000000000000000000", 33);
-            rc = -1;
-            goto fin;
-        }
+    call->bus = bus;
+    call->units = units;
 
-        if (written > (int)remaining)
-            /* The remaining buffer was not sufficient */
-            break;
+    rc = sd_bus_message_new_method_call(bus->bus,
+                                        &m,
+                                        SD_DESTINATION,
+                                        SD_OPATH,
+                                        SD_IFACE("Manager"),
+                                        bus_str_operations[op]);
+    if (rc < 0)
+        sm_err_set("Cannot send operation %s to bus: %s", bus_str_operations[op], strerror(-rc));
 
-        ptr += written;
-        remaining -= written;
-    }
+    rc = sd_bus_message_append_strv(m, units);
+    if (rc < 0)
+        sm_err_set("Cannot send operation %s to bus: %s", bus_str_operations[op], strerror(-rc));
 
-    *ptr = '\0';  // Null termination
+    /* Enable and mask also take the force flag */
+    if (op == ENABLE || op == MASK)
+        rc = sd_bus_message_append(m, "bb", false, true);
+    else
+        rc = sd_bus_message_append(m, "b", false);
+    if (rc < 0)
+        sm_err_set("Cannot send operation %s to bus: %s", bus_str_operations[op], strerror(-rc));
 
-fin:
-    sd_bus_message_unref(reply);
-    sd_bus_error_free(&error);
-    return rc;
-}
+    sm_stats_call(bus_str_operations[op]);
+    rc = sd_bus_call_async(bus->bus, NULL, m, bus_unit_files_reply, (void *)call, 0);
+    if (rc < 0)
+        sm_err_set("Cannot send operation %s to bus: %s", bus_str_operations[op], strerror(-rc));
 
+    sd_bus_message_unref(m);
+    return rc >= 0;
+}
 
-void bus_fetch_service_status(Bus *bus, Service *svc)
+/* Send queued operations until the in-flight limit is reached */
+static void bus_operation_pump(Bus *bus)
 {
-    bus_invocation_id(bus, svc);
-    bus_unit_property(bus, svc->object, SD_IFACE("Unit"), "FragmentPath", "s", &svc->fragment_path, 0);
-
-    switch (svc->type) {
-        case SERVICE:
-            bus_unit_property(bus, svc->object, SD_IFACE("Service"), "ExecMainStartTimestamp", "t", &svc->exec_main_start, sizeof(svc->exec_main_start));
-            bus_unit_property(bus, svc->object, SD_IFACE("Service"), "ExecMainPID", "u", &svc->main_pid, sizeof(svc->main_pid));
-            bus_unit_property(bus, svc->object, SD_IFACE("Service"), "TasksCurrent", "t", &svc->tasks_current, sizeof(svc->tasks_current));
-            bus_unit_property(bus, svc->object, SD_IFACE("Service"), "TasksMax", "t", &svc->tasks_max, sizeof(svc->tasks_max));
-            bus_unit_property(bus, svc->object, SD_IFACE("Service"), "MemoryCurrent", "t", &svc->memory_current, sizeof(svc->memory_current));
-            bus_unit_property(bus, svc->object, SD_IFACE("Service"), "MemoryPeak", "t", &svc->memory_peak, sizeof(svc->memory_peak));
-            bus_unit_property(bus, svc->object, SD_IFACE("Service"), "MemorySwapCurrent", "t", &svc->swap_current, sizeof(svc->swap_current));
-            bus_unit_property(bus, svc->object, SD_IFACE("Service"), "MemorySwapPeak", "t", &svc->swap_peak, sizeof(svc->swap_peak));
-            bus_unit_property(bus, svc->object, SD_IFACE("Service"), "MemoryZSwapCurrent", "t", &svc->zswap_current, sizeof(svc->zswap_current));
-            bus_unit_property(bus, svc->object, SD_IFACE("Service"), "CPUUsageNSec", "t", &svc->cpu_usage, sizeof(svc->cpu_usage));
-            bus_unit_property(bus, svc->object, SD_IFACE("Service"), "ControlGroup", "s", &svc->cgroup, 0);
-            break;
-        case DEVICE:
-            bus_unit_property(bus, svc->object, SD_IFACE("Device"), "SysFSPath", "s", &svc->sysfs_path, 0);
-            break;
-        case MOUNT:
-            bus_unit_property(bus, svc->object, SD_IFACE("Mount"), "Where", "s", &svc->mount_where, 0);
-            bus_unit_property(bus, svc->object, SD_IFACE("Mount"), "What", "s", &svc->mount_what, 0);
-            break;
-        case TIMER:
-            bus_unit_property(bus, svc->object, SD_IFACE("Timer"), "NextElapseUSecRealtime", "t", &svc->next_elapse, sizeof(svc->next_elapse));
-            break;
-        case SOCKET:
-            bus_unit_property(bus, svc->object, SD_IFACE("Socket"), "BindIPv6Only", "s", &svc->bind_ipv6_only, 0);
-            bus_unit_property(bus, svc->object, SD_IFACE("Socket"), "Backlog", "u", &svc->backlog, sizeof(svc->backlog));
-            break;
-        case PATH:
-            break;
-        case SLICE:
-        case TARGET:
-        case SCOPE:
-        case AUTOMOUNT:
-        case SWAP:
-        case SNAPSHOT:
-            break;
-        default:
-            break;
+    Service *svc = NULL;
+    int rc;
+
+    while (bus->op_inflight < BUS_MAX_INFLIGHT && !TAILQ_EMPTY(&bus->operations)) {
+        svc = TAILQ_FIRST(&bus->operations);
+        TAILQ_REMOVE(&bus->operations, svc, opq);
+        svc->op_queued = false;
+
+        sm_stats_call(bus_str_operations[svc->op]);
+        rc = sd_bus_call_method_async(bus->bus,
+                                      &svc->op_slot,
+                                      SD_DESTINATION,
+                                      SD_OPATH,
+                                      SD_IFACE("Manager"),
+                                      bus_str_operations[svc->op],
+                                      bus_operation_reply,
+                                      (void *)svc,
+                                      "ss",
+                                      svc->unit,
+                                      "replace");
+        if (rc < 0)
+            sm_err_set("Cannot send operation %s to bus: %s", bus_str_operations[svc->op], strerror(-rc));
+
+        bus->op_inflight++;
     }
 }
 
-int bus_operation(Bus *bus, Service *svc, enum operation op) {
-    sd_bus_error error = SD_BUS_ERROR_NULL;
-    sd_bus_message *reply = NULL, *m = NULL;
-    int rc = 0;
+/* Queue an operation which queues a job, one still waiting on the unit is replaced */
+static void bus_operation_queue(Bus *bus, Service *svc, enum operation op)
+{
+    bus_operation_cancel(svc);
+    svc->op = op;
+    svc->op_queued = true;
+    TAILQ_INSERT_TAIL(&bus->operations, svc, opq);
+}
 
-    const char *bus_str_operations[] = {
-        "StartUnit",
-        "StopUnit",
-        "RestartUnit",
-        "EnableUnitFiles",
-        "DisableUnitFiles",
-        "MaskUnitFiles",
-        "UnmaskUnitFiles",
-        "ReloadUnit"
-    };
+/**
+ * Sends an operation on a unit to systemd without waiting for it.
+ *
+ * Replies are handled by the event loop, errors systemd returns are shown
+ * in a window then.
+ *
+ * @param bus The bus of the unit.
+ * @param svc The unit to operate on.
+ * @param op The operation.
+ * @return true if the operation was sent.
+ */
+int bus_operation(Bus *bus, Service *svc, enum operation op) {
+    char **units = NULL;
 
     if (op < START || op >= MAX_OPERATIONS)
         sm_err_set("Invalid operation");
 
-    sd_bus_ref(bus->bus);
-
     switch (op) {
         case ENABLE:
+        case DISABLE:
         case MASK:
-        rc = sd_bus_message_new_method_call(bus->bus,
-                                            &m,
-                                            SD_DESTINATION,
-                                            SD_OPATH,
-                                            SD_IFACE("Manager"),
-                                            bus_str_operations[op]);
-        if (rc < 0)
-            sm_err_set("Cannot send operation %s to bus: %s", bus_str_operations[op], strerror(-rc));
-
-        rc = sd_bus_message_append_strv(m, (char*[]) { (char*)svc->unit, NULL });
-        if (rc < 0)
-            sm_err_set("Cannot send operation %s to bus: %s", bus_str_operations[op], strerror(-rc));
+        case UNMASK:
+        units = calloc(2, sizeof(char *));
+        if (!units || !(units[0] = strdup(svc->unit)))
+            sm_err_set("Cannot send operation %s to bus: %s", bus_str_operations[op], strerror(errno));
+        return bus_unit_files_operation(bus, units, op);
 
-        rc = sd_bus_message_append(m, "bb", false, true);
-        if (rc < 0)
-            sm_err_set("Cannot send operation %s to bus: %s", bus_str_operations[op], strerror(-rc)); 
+        default:
+        bus_operation_queue(bus, svc, op);
+        bus_operation_pump(bus);
+        return true;
+    }
+}
 
-        rc = sd_bus_call(bus->bus, m, 0, &error, &reply);
-        if (sd_bus_error_is_set(&error)) {
-            sm_err_window("%s", error.message);
-            break;
-        }
+/**
+ * Sends an operation on every marked unit of a bus.
+ *
+ * Unit file operations go out as one call naming all the units. Other
+ * operations are sent without waiting for each other, up to BUS_MAX_INFLIGHT
+ * at a time, so the replies overlap instead of costing a round trip each.
+ *
+ * @param bus The bus whose marked units are operated on.
+ * @param op The operation.
+ * @return true if the operation was sent.
+ */
+int bus_operation_marked(Bus *bus, enum operation op)
+{
+    struct service_array *all = &bus->by_type[ALL];
+    char **units = NULL;
+    int n = 0;
 
-        if (rc < 1)
-            sm_err_set("Cannot send operation %s to bus: %s", bus_str_operations[op], strerror(-rc));
-        break;
+    if (op < START || op >= MAX_OPERATIONS)
+        sm_err_set("Invalid operation");
 
+    switch (op) {
+        case ENABLE:
         case DISABLE:
+        case MASK:
         case UNMASK:
-        rc = sd_bus_message_new_method_call(bus->bus,
-                                            &m,
-                                            SD_DESTINATION,
-                                            SD_OPATH,
-                                            SD_IFACE("Manager"),
-                                            bus_str_operations[op]);
-        if (rc < 0)
-            sm_err_set("Cannot send operation %s to bus: %s", bus_str_operations[op], strerror(-rc));
-
-        rc = sd_bus_message_append_strv(m, (char*[]) { (char*)svc->unit, NULL });
-        if (rc < 0)
-            sm_err_set("Cannot send operation %s to bus: %s", bus_str_operations[op], strerror(-rc));
+        units = calloc(bus->n_marked + 1, sizeof(char *));
+        if (!units)
+            sm_err_set("Cannot send operation %s to bus: %s", bus_str_operations[op], strerror(errno));
 
-        rc = sd_bus_message_append(m, "b", false);
-        if (rc < 0)
-            sm_err_set("Cannot send operation %s to bus: %s", bus_str_operations[op], strerror(-rc));
+        for (int i = 0; i < all->len && n < bus->n_marked; i++) {
+            if (!all->items[i]->marked)
+                continue;
 
-        rc = sd_bus_call(bus->bus, m, 0, &error, &reply);
-        if (sd_bus_error_is_set(&error)) {
-            sm_err_window("%s", error.message);
-            break;
+            units[n] = strdup(all->items[i]->unit);
+            if (!units[n++])
+                sm_err_set("Cannot send operation %s to bus: %s", bus_str_operations[op], strerror(errno));
         }
-
-        if (rc < 0)
-            sm_err_set("cannot send operation %s to bus: %s", bus_str_operations[op], strerror(-rc));
-        break;
+        return bus_unit_files_operation(bus, units, op);
 
         default:
-        rc = sd_bus_call_method(bus->bus,
-                               SD_DESTINATION,
-                               SD_OPATH,
-                               SD_IFACE("Manager"),
-                               bus_str_operations[op],
-                               &error,
-                               &reply,
-                               "ss",
-                               svc->unit,
-                               "replace");
-
-        if (sd_bus_error_is_set(&error)) {
-            sm_err_window("%s", error.message);
-            break;
+        for (int i = 0; i < all->len; i++) {
+            if (all->items[i]->marked)
+                bus_operation_queue(bus, all->items[i], op);
         }
-
-        if (rc < 0)
-            sm_err_set("Cannot send operation %s to bus: %s", bus_str_operations[op], strerror(-rc));
-        break;
+        bus_operation_pump(bus);
+        return true;
     }
+}
 
-    sd_bus_error_free(&error);
-    sd_bus_message_unref(m);
-    sd_bus_message_unref(reply);
-    sd_bus_unref(bus->bus);
+/* Drop a queued or unanswered operation, e.g. before its unit is freed */
+void bus_operation_cancel(Service *svc)
+{
+    if (svc->op_queued) {
+        TAILQ_REMOVE(&svc->bus->operations, svc, opq);
+        svc->op_queued = false;
+    }
 
-    return rc;
+    if (svc->op_slot) {
+        svc->op_slot = sd_bus_slot_unref(svc->op_slot);
+        svc->bus->op_inflight--;
+    }
 }
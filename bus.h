@@ -2,6 +2,10 @@
 #define _BUS_H_
 #include <stdbool.h>
 #include <systemd/sd-bus.h>
+#include <systemd/sd-event.h>
+#include "sm_arena.h"
+#include "sm_hash.h"
+#include "sm_pool.h"
 
 typedef struct bus_state Bus;
 
@@ -10,6 +14,10 @@ typedef struct bus_state Bus;
 #define SD_DESTINATION "org.freedesktop.systemd1"
 #define SD_IFACE(x)    "org.freedesktop.systemd1." x
 #define SD_OPATH       "/org/freedesktop/systemd1"
+#define SD_UNIT_OPATH  SD_OPATH "/unit"
+
+/* Upper bound of asynchronous property lookups in flight per bus */
+#define BUS_MAX_INFLIGHT 64
 
 #define BUS_CPY_PROPERTY(svc, src) {\
     free(svc->src);\
@@ -18,24 +26,102 @@ typedef struct bus_state Bus;
         sm_err_set("Failed to update %s property", #src);\
 }
 
+/* A unit file operation in flight, see bus_operation_marked() */
+struct bus_unit_files {
+    Bus *bus;
+    char **units;
+};
+
+/* Properties looked up one unit at a time */
+enum bus_lookup {
+    LOOKUP_FILE_STATE = 1 << 0
+};
+
 enum bus_type {
     SYSTEM = 0,
     USER
 };
 
+/* A unit as listed by the manager, see bus_dump_units() */
+struct bus_unit {
+    enum bus_type type;
+    const char *unit;
+    const char *description;
+    const char *load;
+    const char *active;
+    const char *sub;
+    const char *object;
+    const char *unit_file_state;
+};
+
+typedef void (*bus_unit_cb)(const struct bus_unit *u, void *data);
+
 struct bus_state {
     enum bus_type type;
     bool reloading;
     sd_bus *bus;
-    int total_types[MAX_TYPES];
     service_list services;
+
+    /* Per type sorted views, the ALL entry holds every service */
+    struct service_array by_type[MAX_TYPES];
+
+    /* Per type usage orders, kept up to date as samples change while the
+     * list is sorted by usage_sort. Empty while it is sorted by name. */
+    sm_tree by_usage[MAX_TYPES];
+    enum service_sort usage_sort;
+
+    /* The units of one type matching the search, in list order. A longer
+     * search narrows it down, anything else fills it again. */
+    struct service_array by_search;
+    enum service_type search_mode;
+    char search[SERVICE_SEARCH_MAX];
+    bool search_dirty;
+
+    /* Services indexed by unit name and by object path */
+    sm_hash names;
+    sm_hash objects;
+
+    /* The service records, and their unit names, object paths, descriptions
+     * and search keys. The strings are compacted after large prunes. */
+    sm_pool records;
+    sm_arena strings;
+
+    /* Units waiting for a property lookup */
+    int inflight;
+    service_list pending;
+
+    /* Operations waiting to be sent, and those sent but not answered yet */
+    service_list operations;
+    int op_inflight;
+
+    /* Units marked to be operated on together */
+    int n_marked;
+
+    /* The enumeration in flight, the unit list is joined with the unit file
+     * list once both replies are in */
+    sd_bus_slot *files_slot;
+    sd_bus_slot *units_slot;
+    sd_bus_message *files_reply;
+    sd_bus_message *units_reply;
+
+    /* Units the manager announced or removed since the last flush, the
+     * removed ones are still listed until then */
+    char **new_units;
+    int n_new_units;
+    int cap_new_units;
+    int n_removed;
+    int by_names_inflight;
+    sd_event_source *changes;
 };
 
 Bus * bus_currently_displayed(void);
 bool bus_system_only(void);
+int bus_dump_units(enum bus_type type, bus_unit_cb cb, void *data);
 int bus_init(void);
-int bus_invocation_id(Bus *bus, Service *svc);
 int bus_operation(Bus *bus, Service *svc, enum operation op);
+int bus_operation_marked(Bus *bus, enum operation op);
 void bus_fetch_service_status(Bus *bus, Service *svc);
-void bus_update_unit_file_state(Bus *bus, Service *svc);
+void bus_fetch_service_status_cancel(void);
+void bus_operation_cancel(Service *svc);
+void bus_unit_lookup_cancel(Bus *bus, Service *svc);
 #endif
@@ -0,0 +1,295 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <systemd/sd-event.h>
+#include "sm_err.h"
+#include "service.h"
+#include "display.h"
+#include "cgroup.h"
+
+/* Samples the displayed bus while the usage columns or a usage order are shown */
+static sd_event_source *cgroup_source = NULL;
+static bool enabled = false;
+
+/**
+ * Reads a control group attribute file.
+ *
+ * @param dfd The control group directory.
+ * @param name The attribute, e.g. "memory.current".
+ * @param buf Receives the NUL terminated contents.
+ * @param size The size of buf.
+ * @return The length read, or -1 if the file is missing, e.g. the controller is off.
+ */
+static ssize_t cgroup_read(int dfd, const char *name, char *buf, size_t size)
+{
+    ssize_t len;
+    int fd;
+
+    fd = openat(dfd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    len = read(fd, buf, size - 1);
+    close(fd);
+    if (len < 0)
+        return -1;
+
+    buf[len] = '\0';
+    return len;
+}
+
+/* Return the value of a "key value" line, as found in cpu.stat */
+static uint64_t cgroup_keyed(const char *buf, const char *key)
+{
+    size_t klen = strlen(key);
+    const char *p = buf;
+
+    while (p) {
+        if (strncmp(p, key, klen) == 0 && p[klen] == ' ')
+            return strtoull(p + klen + 1, NULL, 10);
+
+        p = strchr(p, '\n');
+        if (p)
+            p++;
+    }
+
+    return 0;
+}
+
+/* Sum the bytes read and written over every device line of io.stat */
+static uint64_t cgroup_io_bytes(const char *buf)
+{
+    uint64_t bytes = 0;
+    const char *p = buf;
+
+    /* rbytes= and wbytes=, but not dbytes= which counts discards */
+    while ((p = strstr(p, "bytes="))) {
+        if (p > buf && (p[-1] == 'r' || p[-1] == 'w'))
+            bytes += strtoull(p + 6, NULL, 10);
+        p += 6;
+    }
+
+    return bytes;
+}
+
+/**
+ * Samples the control group of a unit and updates its rates.
+ *
+ * CPU and I/O are cumulative counters, their rates are taken against the
+ * previous sample. The first sample of a unit only sets the baseline.
+ *
+ * @param svc The unit.
+ * @param dfd The control group directory of the unit.
+ * @param now The time of this sampling pass.
+ */
+static void cgroup_sample_unit(Service *svc, int dfd, uint64_t now)
+{
+    char buf[CGROUP_BUF_MAX];
+    uint64_t cpu = 0, memory = 0, tasks = 0, io = 0;
+    uint64_t elapsed;
+
+    /* Already sampled in this pass, the rates need time to pass */
+    if (svc->sampled == now)
+        return;
+
+    if (cgroup_read(dfd, "cpu.stat", buf, sizeof(buf)) > 0)
+        cpu = cgroup_keyed(buf, "usage_usec");
+    if (cgroup_read(dfd, "memory.current", buf, sizeof(buf)) > 0)
+        memory = strtoull(buf, NULL, 10);
+    if (cgroup_read(dfd, "pids.current", buf, sizeof(buf)) > 0)
+        tasks = strtoull(buf, NULL, 10);
+    if (cgroup_read(dfd, "io.stat", buf, sizeof(buf)) > 0)
+        io = cgroup_io_bytes(buf);
+
+    if (svc->sampled) {
+        elapsed = now - svc->sampled;
+        svc->cpu_percent = cpu >= svc->cpu_usec ? (cpu - svc->cpu_usec) * 100.0 / elapsed : 0;
+        svc->memory_delta = (int64_t)(memory - svc->memory_current);
+        svc->io_rate = io >= svc->io_bytes ? (io - svc->io_bytes) * 1000000 / elapsed : 0;
+    }
+
+    svc->cpu_usec = cpu;
+    svc->io_bytes = io;
+    svc->memory_current = memory;
+    svc->tasks_current = tasks;
+    svc->sampled = now;
+
+    service_usage_changed(svc);
+}
+
+/* Drop the usage of a unit which no longer has a control group */
+static void cgroup_forget(Service *svc)
+{
+    svc->sampled = 0;
+    svc->cpu_usec = 0;
+    svc->io_bytes = 0;
+    svc->cpu_percent = 0;
+    svc->memory_delta = 0;
+    svc->io_rate = 0;
+    svc->memory_current = 0;
+    svc->tasks_current = 0;
+
+    service_usage_changed(svc);
+}
+
+/**
+ * Samples every control group below a directory that belongs to a unit of
+ * the bus. Units are only nested below slices, so the walk does not descend
+ * into other units, whose subgroups are theirs to manage.
+ *
+ * @param bus The bus whose units are looked up.
+ * @param dfd The directory to walk, it is closed on return.
+ * @param now The time of this sampling pass.
+ */
+static void cgroup_walk(Bus *bus, int dfd, uint64_t now)
+{
+    struct dirent *de = NULL;
+    Service *svc = NULL;
+    DIR *dir = NULL;
+    const char *name;
+    bool slice;
+    int fd;
+
+    dir = fdopendir(dfd);
+    if (!dir) {
+        close(dfd);
+        return;
+    }
+
+    while ((de = readdir(dir))) {
+        if (de->d_type != DT_DIR || de->d_name[0] == '.')
+            continue;
+
+        /* Names that clash with attribute files are escaped with a leading _ */
+        name = de->d_name[0] == '_' ? de->d_name + 1 : de->d_name;
+        svc = service_get_name(bus, name);
+
+        slice = strlen(name) > 6 && strcmp(name + strlen(name) - 6, ".slice") == 0;
+        if (!svc && !slice)
+            continue;
+
+        fd = openat(dirfd(dir), de->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+
+        if (svc)
+            cgroup_sample_unit(svc, fd, now);
+
+        if (slice)
+            cgroup_walk(bus, fd, now);
+        else
+            close(fd);
+    }
+
+    closedir(dir);
+}
+
+/**
+ * Samples the resource usage of every unit of a bus from cgroupfs.
+ *
+ * System units live in the whole hierarchy, user units below the user
+ * manager of the current user.
+ *
+ * @param bus The bus to sample.
+ */
+void cgroup_sample(Bus *bus)
+{
+    struct service_array *all = &bus->by_type[ALL];
+    char path[PATH_MAX];
+    uid_t uid = geteuid();
+    uint64_t now = service_now();
+    int fd;
+
+    if (bus->type == USER)
+        snprintf(path, sizeof(path), "%s/user.slice/user-%u.slice/user@%u.service", CGROUP_ROOT, uid, uid);
+    else
+        snprintf(path, sizeof(path), "%s", CGROUP_ROOT);
+
+    fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0)
+        cgroup_walk(bus, fd, now);
+
+    /* Units not found in this pass were stopped or have no control group */
+    for (int i = 0; i < all->len; i++) {
+        if (all->items[i]->sampled && all->items[i]->sampled != now)
+            cgroup_forget(all->items[i]);
+    }
+
+    display_schedule_redraw();
+}
+
+/* Sample again in usec from now */
+static void cgroup_arm(uint64_t usec)
+{
+    int rc;
+
+    rc = sd_event_source_set_time(cgroup_source, usec + CGROUP_INTERVAL_USEC);
+    if (rc < 0)
+        sm_err_set("Cannot set sampling timer: %s\n", strerror(-rc));
+
+    rc = sd_event_source_set_enabled(cgroup_source, SD_EVENT_ONESHOT);
+    if (rc < 0)
+        sm_err_set("Cannot enable sampling timer: %s\n", strerror(-rc));
+}
+
+/* Timer callback which samples the displayed bus */
+static int cgroup_tick(sd_event_source *s, uint64_t usec, void *data)
+{
+    (void)s;
+    (void)data;
+
+    cgroup_sample(bus_currently_displayed());
+    cgroup_arm(usec);
+    return 0;
+}
+
+/* Start or stop sampling, the first sample is taken right away */
+void cgroup_set_enabled(bool enable)
+{
+    int rc;
+
+    if (enable == enabled)
+        return;
+
+    enabled = enable;
+    if (enabled) {
+        cgroup_sample(bus_currently_displayed());
+        cgroup_arm(service_now());
+        return;
+    }
+
+    rc = sd_event_source_set_enabled(cgroup_source, SD_EVENT_OFF);
+    if (rc < 0)
+        sm_err_set("Cannot stop sampling timer: %s\n", strerror(-rc));
+}
+
+void cgroup_init(void)
+{
+    sd_event *ev = NULL;
+    int rc;
+
+    rc = sd_event_default(&ev);
+    if (rc < 0)
+        sm_err_set("Cannot initialize event loop: %s\n", strerror(-rc));
+
+    /* The sampling timer stays off until usage is shown */
+    rc = sd_event_add_time(ev,
+                           &cgroup_source,
+                           CLOCK_MONOTONIC,
+                           0,
+                           1000,
+                           cgroup_tick,
+                           NULL);
+    if (rc < 0)
+        sm_err_set("Cannot initialize sampling timer: %s\n", strerror(-rc));
+
+    rc = sd_event_source_set_enabled(cgroup_source, SD_EVENT_OFF);
+    if (rc < 0)
+        sm_err_set("Cannot initialize sampling timer: %s\n", strerror(-rc));
+
+    sd_event_unref(ev);
+}
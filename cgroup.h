@@ -0,0 +1,20 @@
+#ifndef _CGROUP_H_
+#define _CGROUP_H_
+#include <stdbool.h>
+#include "bus.h"
+
+/* Where the unified (v2) control group hierarchy is mounted */
+#ifndef CGROUP_ROOT
+#define CGROUP_ROOT "/sys/fs/cgroup"
+#endif
+
+/* How often the control groups of the displayed units are sampled */
+#define CGROUP_INTERVAL_USEC 1000000LLU
+
+/* Largest control group attribute file read, io.stat has a line per device */
+#define CGROUP_BUF_MAX 8192
+
+void cgroup_init(void);
+void cgroup_sample(Bus *bus);
+void cgroup_set_enabled(bool enabled);
+#endif
@@ -5,121 +5,322 @@
 #include "sm_err.h"
 #include "service.h"
 #include "display.h"
+#include "journal.h"
+#include "cgroup.h"
+#include "sm_stats.h"
 
 static uint64_t start_time = 0;
 static enum service_type mode = SERVICE;
 static enum bus_type type = SYSTEM;
+static enum service_sort sort = SORT_NAME;
 static int index_start = 0;
 static int position = 0;
 static uid_t euid = INT32_MAX;
 
+/* Object path of the selected unit, keeps the cursor on it when the list changes */
+static char *anchor = NULL;
+
+/* Frames are rendered from a timer, at most once per frame interval */
+static sd_event_source *frame_source = NULL;
+static uint64_t frame_interval = 1000000 / D_FPS;
+static uint64_t last_frame = 0;
+
+/* The service shown on each row of the list, filled in by every frame */
+static Service **rows = NULL;
+static int nrows = 0;
+
+/* Text last painted into each column of a list row */
+struct display_line {
+    char *field[D_NFIELDS];
+    bool selected;
+};
+
+/* What is on the screen right now, only cells that differ get written */
+static struct display_line *lines = NULL;
+static char *header[D_NHEADER] = {NULL};
+
+/* The list is filtered by the search, which is being typed while searching */
+static char search[SERVICE_SEARCH_MAX] = {0};
+static bool searching = false;
+
+/* The description column shows the sampled usage of the units instead */
+static bool show_usage = false;
+
+/* Border, headline and column lines need to be drawn again */
+static bool repaint = true;
+
+/* The popup shown above the list, the next key press closes it */
+static WINDOW *popup = NULL;
+static char *popup_text = NULL;
+static char *popup_title = NULL;
+static bool popup_dirty = false;
+
+/* The unit shown in the status popup, its details are refreshed while it is open */
+static Bus *status_bus = NULL;
+static Service *status_svc = NULL;
+static sd_event_source *status_source = NULL;
+static char status_invocation_id[33] = {0};
+
+/* How far the logs in the status popup are scrolled back, in lines, and how
+ * many of them fit below the details */
+static int status_scroll = 0;
+static int status_fit = 1;
+
+/* The performance overlay, refreshed every second while it is shown */
+static WINDOW *stats_win = NULL;
+static bool show_stats = false;
+static sd_event_source *stats_source = NULL;
+
 extern const char **service_str_types;
 
 
 /**
- * Prints the service information for the specified index and row.
+ * Copies a string into a buffer, cutting it to fit into a column.
  *
- * If the current row matches the position, the service information is printed with
- * a highlighted background. Otherwise, the service information is printed with a
- * normal background.
+ * @param dst The buffer to copy to, at least width + 1 bytes long.
+ * @param src The string to copy.
+ * @param width The width of the column.
+ * @param ellipsis If true, a cut string ends with "..."
+ */
+static void display_clip(char *dst, const char *src, size_t width, bool ellipsis)
+{
+    size_t len = strlen(src);
+
+    if (len <= width) {
+        memcpy(dst, src, len + 1);
+        return;
+    }
+
+    if (ellipsis && width >= 3) {
+        memcpy(dst, src, width - 3);
+        memcpy(dst + width - 3, "...", 4);
+    }
+    else {
+        memcpy(dst, src, width);
+        dst[width] = '\0';
+    }
+}
+
+/**
+ * Paints text into a screen cell, unless the cell already shows it.
  *
- * The service information includes the unit name, load state, active state, sub state,
- * and description. If the service information is too long to fit in the available
- * space, it is truncated and an ellipsis is added.
+ * The text last painted into the cell is kept in cache. If the new text is
+ * shorter, only the leftover characters are blanked.
  *
- * @param i The index of the service to print.
- * @param row The row to print the service information on.
+ * @param y The row of the cell.
+ * @param x The column the cell starts at.
+ * @param cache The text currently shown in the cell, updated on return.
+ * @param text The text to show.
+ * @param attr The attributes to paint the text with.
+ * @param force Paint the text even if it is unchanged, e.g. when attr changed.
  */
-static int display_row(Service *svc, int row)
+static void display_paint(int y, int x, char **cache, const char *text, attr_t attr, bool force)
 {
+    int len = strlen(text);
+    int old = *cache ? strlen(*cache) : 0;
+    char *cpy = NULL;
 
-    char short_unit[D_XLOAD - 2];
-    char short_unit_file_state[10];
-    char *short_description;
-    size_t maxx_description = getmaxx(stdscr) - D_XDESCRIPTION - 1;
+    if (!force && *cache && strcmp(*cache, text) == 0)
+        return;
 
-    if(position == row) {
-        attron(COLOR_PAIR(8));
-        attron(A_BOLD);
+    cpy = strdup(text);
+    if (!cpy)
+        sm_err_set("Cannot allocate screen cell: %s\n", strerror(errno));
+
+    attrset(attr);
+    mvaddstr(y, x, text);
+    attrset(A_NORMAL);
+
+    if (old > len)
+        mvhline(y, x + len, ' ', old - len);
+
+    free(*cache);
+    *cache = cpy;
+}
+
+/* Forget what is on the screen, the next frame paints everything again */
+static void display_invalidate(void)
+{
+    for (int i = 0; i < nrows; i++) {
+        for (int f = 0; f < D_NFIELDS; f++) {
+            free(lines[i].field[f]);
+            lines[i].field[f] = NULL;
+        }
+        lines[i].selected = false;
     }
-    else {
-        attroff(COLOR_PAIR(8));
-        attroff(A_BOLD);
+
+    for (int i = 0; i < D_NHEADER; i++) {
+        free(header[i]);
+        header[i] = NULL;
     }
 
-    if (mode != ALL && mode != svc->type)
-        return 0;
+    erase();
+    repaint = true;
+    popup_dirty = true;
+}
 
-    // if the unit name is too long, truncate it and add ...
-    if(strlen(svc->unit) >= D_XLOAD -3) {
-        strncpy(short_unit, svc->unit, D_XLOAD - 2);
-        mvaddstr(row + 4, 1, short_unit);
-        mvaddstr(row + 4, D_XLOAD - 4, "...");
+/* Format a byte count with a binary unit, e.g. 1.5M. With sign, positive counts get a + */
+static void display_bytes(char *dst, size_t size, int64_t bytes, bool sign)
+{
+    static const char units[] = "BKMGTP";
+    double value = bytes < 0 ? -(double)bytes : (double)bytes;
+    int u = 0;
+
+    while (value >= 1024 && u < 5) {
+        value /= 1024;
+        u++;
     }
-    else
-        mvaddstr(row + 4, 1, svc->unit);
 
-    // if the state is too long, truncate it (enabled-runtime will be enabled-r)
-    if (!svc->unit_file_state || strlen(svc->unit_file_state) == 0)
-        mvprintw(row + 4, D_XLOAD, "%s", svc->load);
-    else if (strlen(svc->unit_file_state) > 9)
-    {
-        strncpy(short_unit_file_state, svc->unit_file_state, 9);
-        short_unit_file_state[9] = '\0';
-        mvaddstr(row + 4, D_XLOAD, short_unit_file_state);
+    snprintf(dst, size, "%s%.*f%c", bytes < 0 ? "-" : (sign && bytes ? "+" : ""), u ? 1 : 0, value, units[u]);
+}
+
+/* Format the usage columns of a unit, the sampled ones stay blank until the unit was sampled */
+static void display_usage(char *dst, size_t size, Service *svc)
+{
+    char memory[16], delta[16], io[16];
+    int len;
+
+    if (!svc->sampled)
+        len = snprintf(dst, size, "%6s %9s %9s %6s %9s", "", "", "", "", "");
+    else {
+        display_bytes(memory, sizeof(memory), svc->memory_current, false);
+        display_bytes(delta, sizeof(delta), svc->memory_delta, true);
+        display_bytes(io, sizeof(io), svc->io_rate, false);
+
+        /* Keep in line with the titles in display_text_and_lines() */
+        len = snprintf(dst, size, "%6.1f %9s %9s %6lu %9s", svc->cpu_percent, memory, delta, svc->tasks_current, io);
     }
+
+    if (svc->type == SERVICE && len > 0 && (size_t)len < size)
+        snprintf(dst + len, size - len, " %9u", svc->n_restarts);
+}
+
+/* Put the job of the unit in front of the last column, while it runs and how it ended */
+static const char * display_job(char *dst, size_t size, Service *svc, const char *text)
+{
+    if (svc->job)
+        snprintf(dst, size, "[%s...] %s", svc->job_type, text);
+    else if (svc->job_result)
+        snprintf(dst, size, "[%s: %s] %s", svc->job_type, svc->job_result, text);
     else
-        mvprintw(row + 4, D_XLOAD, "%s", svc->unit_file_state ? svc->unit_file_state : svc->load);
-
-    mvprintw(row + 4, D_XACTIVE, "%s", svc->active);
-    mvprintw(row + 4, D_XSUB, "%s", svc->sub);
-    // if the description is too long, truncate it and add ...
-    if(strlen(svc->description) >= maxx_description) {
-        short_description = alloca(maxx_description+1);
-        memset(short_description, 0, maxx_description+1);
-        strncpy(short_description, svc->description, maxx_description - 3);
-        mvaddstr(row + 4, D_XDESCRIPTION, short_description);
-        mvaddstr(row + 4, D_XDESCRIPTION + maxx_description - 3, "...");
+        return text;
+
+    return dst;
+}
+
+/**
+ * Prints the service information on the specified row.
+ *
+ * If the current row matches the position, the service information is printed with
+ * a highlighted background. Otherwise, the service information is printed with a
+ * normal background.
+ *
+ * The service information includes the unit name, load state, active state, sub state,
+ * and description, or its resource usage when that is shown. A job queued for the unit
+ * is shown in front of the last column. If the service information is too long to fit in the available
+ * space, it is truncated and an ellipsis is added. Only the columns which differ
+ * from what the row shows already are written.
+ *
+ * @param svc The service to print, or NULL to blank the row.
+ * @param row The row to print the service information on.
+ */
+static void display_row(Service *svc, int row)
+{
+    static const int xpos[D_NFIELDS] = { 1, D_XLOAD, D_XACTIVE, D_XSUB, D_XDESCRIPTION };
+    int maxx = getmaxx(stdscr);
+    int width[D_NFIELDS] = {
+        D_XLOAD - 2,
+        D_XACTIVE - D_XLOAD - 1,
+        D_XSUB - D_XACTIVE - 1,
+        D_XDESCRIPTION - D_XSUB - 1,
+        maxx - D_XDESCRIPTION - 1
+    };
+    const char *src[D_NFIELDS] = { NULL };
+    char usage[64];
+    char text[(maxx > D_XLOAD ? maxx : D_XLOAD) + 1];
+    char job[sizeof(text)];
+    char name[D_XLOAD];
+    struct display_line *line = &lines[row];
+    bool selected = svc && position == row;
+    attr_t attr = selected ? COLOR_PAIR(8) | A_BOLD : A_NORMAL;
+
+    if (width[D_NFIELDS - 1] < 0)
+        width[D_NFIELDS - 1] = 0;
+
+    if (svc) {
+        src[0] = svc->unit;
+        /* Marked units are flagged in front of their name */
+        if (svc->marked) {
+            snprintf(name, sizeof(name), "* %s", svc->unit);
+            src[0] = name;
+        }
+        /* Units without a unit file show their load state instead */
+        if (svc->unit_file_state && *svc->unit_file_state)
+            src[1] = svc->unit_file_state;
+        else
+            src[1] = svc->load;
+        src[2] = svc->active;
+        src[3] = svc->sub;
+        src[4] = svc->description;
+
+        if (show_usage) {
+            display_usage(usage, sizeof(usage), svc);
+            src[4] = usage;
+        }
+
+        src[4] = display_job(job, sizeof(job), svc, src[4]);
+    }
+
+    for (int i = 0; i < D_NFIELDS; i++) {
+        /* the unit name and description are cut with ..., states are just cut
+         * (enabled-runtime will be enabled-r) */
+        display_clip(text, src[i] ? src[i] : "", width[i], i == 0 || i == D_NFIELDS - 1);
+        display_paint(row + 4, xpos[i], &line->field[i], text, attr, selected != line->selected);
     }
-    else
-        mvaddstr(row + 4, D_XDESCRIPTION, svc->description);
 
-    svc->ypos = row + 4;
-    return 1;
+    line->selected = selected;
+    rows[row] = svc;
 }
 
 static void display_services(Bus *bus)
 {
     int max_rows = getmaxy(stdscr) - 5;
-    int row = 0;
-    int idx = index_start;
-    Service *svc;
 
-    services_invalidate_ypos(bus);
+    if (max_rows < 0)
+        max_rows = 0;
 
-    while (true) {
-        svc = service_nth(bus, idx);
-        if (!svc)
-            break;
+    /* The terminal changed size, start over with an empty screen */
+    if (max_rows != nrows) {
+        Service **r;
+        struct display_line *l;
 
-        if (row >= max_rows)
-            break;
+        display_invalidate();
+
+        r = realloc(rows, (max_rows + 1) * sizeof(Service *));
+        l = realloc(lines, (max_rows + 1) * sizeof(struct display_line));
+        if (!r || !l)
+            sm_err_set("Cannot allocate screen rows: %s\n", strerror(errno));
 
-        row += display_row(svc, row);
-        idx++;
+        rows = r;
+        lines = l;
+        nrows = max_rows;
+        memset(rows, 0, nrows * sizeof(Service *));
+        memset(lines, 0, nrows * sizeof(struct display_line));
     }
+
+    for (int row = 0; row < nrows; row++)
+        display_row(service_nth(bus, index_start + row), row);
 }
 
 /**
  * Prints the text and lines for the main user interface.
- * This function is responsible for rendering the header, function keys, and mode indicators
- * on the screen. It also updates the position and mode information based on the current state.
+ * This function is responsible for rendering the border, headline, function keys,
+ * column titles and lines. These never change, so they are only drawn when the
+ * screen was cleared.
  */
-static void display_text_and_lines(Bus *bus)
+static void display_text_and_lines(void)
 {
-    int x = D_XLOAD / 2 - 10;
     int maxx, maxy;
-    char tmptype[16] = {0};
     getmaxyx(stdscr, maxy, maxx);
 
     attroff(COLOR_PAIR(9));
@@ -138,37 +339,647 @@ static void display_text_and_lines(Bus *bus)
     mvaddstr(1, strlen(D_HEADLINE) + strlen(D_FUNCTIONS) + 3, D_SERVICE_TYPES);
     attroff(COLOR_PAIR(10));
 
-    mvprintw(2, D_XLOAD - 10, "Pos.:%3d", position + index_start);
     mvprintw(2, 1, "UNIT:");
-
-    attron(COLOR_PAIR(4));
-    mvprintw(2, 7, "(%s)", type ? "USER" : "SYSTEM");
-    attroff(COLOR_PAIR(4));
-
     mvprintw(2, 16, "Space: User/System");
     mvprintw(2, D_XLOAD, "STATE:");
     mvprintw(2, D_XACTIVE, "ACTIVE:");
     mvprintw(2, D_XSUB, "SUB:");
-    mvprintw(2, D_XDESCRIPTION, "DESCRIPTION: | Left/Right: Modus | Up/Down: Select | Return: Show status");
-
-    attron(COLOR_PAIR(4));
-    attron(A_UNDERLINE);
-
-    /* Sets the type count */
-    strncpy(tmptype, service_string_type(mode), 16);
-    tmptype[0] = toupper(tmptype[0]);
-    mvprintw(2, x, "%s: %d", tmptype, bus->total_types[mode]);
+    if (show_usage)
+        mvprintw(2, D_XDESCRIPTION, "%6s %9s %9s %6s %9s %9s | U: Description | Tab: Sort",
+                 "CPU%:", "MEMORY:", "DELTA:", "TASKS:", "IO/S:", "RESTARTS:");
+    else
+        mvprintw(2, D_XDESCRIPTION, "DESCRIPTION: | Left/Right: Modus | Up/Down: Select | Return: Show status | U: Usage | /: Search | X/*/-: Mark | F12: Stats");
 
-    attroff(COLOR_PAIR(4));
-    attroff(A_UNDERLINE);
     attroff(A_BOLD);
     mvhline(3, 1, ACS_HLINE, maxx - 2);
     mvvline(2, D_XLOAD - 1, ACS_VLINE, maxy - 3);
     mvvline(2, D_XACTIVE -1, ACS_VLINE, maxy - 3);
     mvvline(2, D_XSUB -1, ACS_VLINE, maxy - 3);
     mvvline(2, D_XDESCRIPTION -1, ACS_VLINE, maxy - 3);
+    attrset(A_NORMAL);
+
+    repaint = false;
+}
+
+/* Updates the header cells which change with the view: bus, type count, order and position */
+static void display_header(Bus *bus)
+{
+    char text[32];
+    char tmptype[16] = {0};
+
+    snprintf(text, sizeof(text), "(%s)", type ? "USER" : "SYSTEM");
+    display_paint(2, 7, &header[0], text, COLOR_PAIR(4) | A_BOLD, false);
+
+    /* Sets the type count */
+    strncpy(tmptype, service_string_type(mode), 15);
+    tmptype[0] = toupper(tmptype[0]);
+    snprintf(text, sizeof(text), "%s: %d", tmptype, service_count(bus));
+    display_paint(2, D_XLOAD / 2 - 10, &header[1], text, COLOR_PAIR(4) | A_BOLD | A_UNDERLINE, false);
+
+    snprintf(text, sizeof(text), "Sort: %s", service_string_sort(sort));
+    display_paint(2, D_XLOAD / 2 + 12, &header[3], text, A_BOLD, false);
+
+    text[0] = '\0';
+    if (bus->n_marked)
+        snprintf(text, sizeof(text), "Marked: %d", bus->n_marked);
+    display_paint(2, D_XLOAD / 2 + 28, &header[5], text, COLOR_PAIR(4) | A_BOLD, false);
+
+    /* Stay clear of the column line */
+    snprintf(text, 10, "Pos.:%3d", position + index_start);
+    display_paint(2, D_XLOAD - 10, &header[2], text, A_BOLD, false);
+}
+
+/* Shows the search on the bottom border while it is typed or filters the list */
+static void display_search_prompt(void)
+{
+    char text[SERVICE_SEARCH_MAX + 8] = {0};
+    int maxy, maxx;
+
+    getmaxyx(stdscr, maxy, maxx);
+
+    if (searching || search[0])
+        snprintf(text, sizeof(text), " /%s%s ", search, searching ? "_" : "");
+
+    if (header[4] && strcmp(header[4], text) == 0)
+        return;
+
+    /* The border under a longer search has to be drawn again */
+    mvhline(maxy - 1, 1, ACS_HLINE, maxx - 2);
+    attron(A_BOLD);
+    mvaddstr(maxy - 1, 2, text);
+    attroff(A_BOLD);
+
+    free(header[4]);
+    header[4] = strdup(text);
+    if (!header[4])
+        sm_err_set("Cannot allocate screen cell: %s\n", strerror(errno));
+}
+
+/**
+ * Handles a key while the search is typed.
+ *
+ * Printable keys extend the search and backspace shortens it, the list is
+ * filtered as it changes. Return keeps the search applied, escape drops it.
+ *
+ * @param c The key pressed.
+ * @return true if the key was taken by the search.
+ */
+static bool display_search_key(int c)
+{
+    size_t len = strlen(search);
+
+    switch (c) {
+        case KEY_RETURN:
+            searching = false;
+            return true;
+
+        case KEY_ESC:
+            searching = false;
+            search[0] = '\0';
+            break;
+
+        case KEY_BACKSPACE:
+        case KEY_DEL:
+        case '\b':
+            if (len == 0)
+                return true;
+            search[len - 1] = '\0';
+            break;
+
+        default:
+            if (c > 255 || !isprint(c))
+                return false;
+            if (len + 1 >= sizeof(search))
+                return true;
+            search[len] = tolower(c);
+            search[len + 1] = '\0';
+            break;
+    }
+
+    position = 0;
+    index_start = 0;
+    return true;
+}
+
+/* Return the service under the cursor. It is looked up in the list rather than
+ * in the rows painted last, as the cursor may have moved since the last frame. */
+static Service * display_selected(Bus *bus)
+{
+    return service_nth(bus, index_start + position);
+}
+
+/* Move the cursor a row down, the list scrolls once it is on the last row */
+static void display_cursor_down(int count, int maxy)
+{
+    if (position < maxy - 6 && index_start + position < count - 1)
+        position++;
+    else if (index_start + position < count - 1)
+        index_start++;
+}
+
+/* Mark every unit in the list, which is narrowed by the type and the search.
+ * If they are all marked already, they are unmarked instead. */
+static void display_mark_listed(Bus *bus)
+{
+    int count = service_count(bus);
+    bool marked = false;
+
+    for (int i = 0; i < count && !marked; i++)
+        marked = !service_nth(bus, i)->marked;
+
+    for (int i = 0; i < count; i++)
+        service_mark(bus, service_nth(bus, i), marked);
+}
+
+/* Unmark every unit of the bus, whether it is listed or not */
+static void display_unmark(Bus *bus)
+{
+    struct service_array *all = &bus->by_type[ALL];
+
+    for (int i = 0; i < all->len && bus->n_marked; i++)
+        service_mark(bus, all->items[i], false);
+}
+
+/* Remember the currently selected unit so the cursor can follow it */
+static void display_anchor(Bus *bus)
+{
+    Service *svc = service_nth(bus, index_start + position);
+
+    free(anchor);
+    anchor = NULL;
+
+    if (svc)
+        anchor = strdup(svc->object);
+}
+
+/* Move the view so the anchored unit stays under the cursor after units
+ * were added or removed. If it is gone, its successor takes its place. */
+static void display_follow_anchor(Bus *bus)
+{
+    int rank, count = service_count(bus);
+
+    if (!anchor) {
+        display_anchor(bus);
+        return;
+    }
+
+    if (count == 0)
+        return;
+
+    /* Like top, a usage order keeps the view still while units move through it */
+    if (sort != SORT_NAME && !search[0]) {
+        if (index_start + position >= count) {
+            index_start = count - 1 - position;
+            if (index_start < 0) {
+                index_start = 0;
+                position = count - 1;
+            }
+        }
+        display_anchor(bus);
+        return;
+    }
+
+    rank = service_rank(bus, anchor);
+    if (rank >= count)
+        rank = count - 1;
+
+    if (rank == index_start + position)
+        return;
+
+    index_start = rank - position;
+    if (index_start < 0) {
+        index_start = 0;
+        position = rank;
+    }
+}
+
+/**
+ * Creates the popup window for the current popup text.
+ *
+ * The window is centered on the screen and sized to fit the text. It is not
+ * refreshed here, display_popup() puts it on top of the list each frame.
+ */
+static void display_popup_build(void)
+{
+    int maxx_row = 0, maxy = 0, maxx = 0;
+    int current_row_length = 0;
+    int text_rows = 0, height = 0, width = 0;
+    int startx = 0, starty = 0;
+    int y = 1, x = 1;
+    int line_length = 0;
+    const char *line_start = NULL;
+    const char *line_end = NULL;
+
+    for (int count = 0; popup_text[count] != '\0'; count++) {
+        if (popup_text[count] == '\n') {
+            text_rows++;
+            if (current_row_length > maxx_row)
+                maxx_row = current_row_length;
+            current_row_length = 0;
+        }
+        else
+            current_row_length++;
+    }
+
+    if(current_row_length > maxx_row)
+        maxx_row = current_row_length;
+
+    getmaxyx(stdscr, maxy, maxx);
+
+    if(text_rows + 2 >= maxy)
+        height = maxy;
+    else
+        height = text_rows + 2;
+    if(text_rows == 0)
+        height = 3;
+
+    if(maxx_row + 4 >= maxx)
+        width = maxx;
+    else
+        width = maxx_row + 4;
+
+    starty = (maxy - height) / 2;
+    startx = (maxx - width) / 2;
+
+    popup = newwin(height, width, starty, startx);
+    if (!popup)
+        return;
+
+    box(popup, 0, 0);
+
+    wattron(popup, A_BOLD);
+    wattron(popup, A_UNDERLINE);
+
+    mvwprintw(popup, 0, (width / 2) - (strlen(popup_title) / 2), "%s", popup_title);
+    wattroff(popup, A_UNDERLINE);
+
+    if(text_rows == 0)
+        wattron(popup, COLOR_PAIR(13));
+
+    line_start = popup_text;
+    while ((line_end = strchr(line_start, '\n')) != NULL && y < height - 1) {
+        line_length = line_end - line_start;
+        if (line_length > width - 2)
+            line_length = width - 6;
+
+        mvwaddnstr(popup, y++, x, line_start, line_length);
+        line_start = line_end + 1;
+    }
+
+    if (y < height - 1)
+        mvwaddnstr(popup, y, x, line_start, width - 2);
+
+    wattroff(popup, COLOR_PAIR(13));
+    wattroff(popup, A_BOLD);
 }
 
+/* Print the count, average and p99 of a latency histogram */
+static void display_stats_latency(int y, const char *name, const sm_stats_hist *h)
+{
+    mvwprintw(stats_win, y, 1, "%-9s %8llu  avg %7.2f ms  p99 %7.2f ms",
+              name,
+              (unsigned long long)h->count,
+              h->count ? h->total / 1000.0 / h->count : 0.0,
+              sm_stats_percentile(h, 0.99) / 1000.0);
+}
+
+/* Print the decades of a latency histogram, as counted since startup */
+static void display_stats_decades(int y, const char *name, const sm_stats_hist *h)
+{
+    mvwprintw(stats_win, y, 1, "%-9s", name);
+    for (int i = 0; i < SM_STATS_DECADES; i++)
+        wprintw(stats_win, " %6llu", (unsigned long long)h->decades[i]);
+}
+
+/**
+ * Draws the performance overlay in the top right corner of the list.
+ *
+ * The window grows with the D-Bus methods seen so far, the rows beneath it
+ * are painted again whenever its size changes.
+ */
+static void display_stats_build(void)
+{
+    static const char *latencies[STATS_MAX_LATENCY] = {"Frames", "Status", "Journal"};
+    static const char *decades[SM_STATS_DECADES] = {"<10us", "<100us", "<1ms", "<10ms", "<100ms", "<1s", ">=1s"};
+    const struct sm_stats *st = sm_stats_get();
+    char written[16], rate[16], rss[16];
+    int height = D_STATS_ROWS + (st->n_methods + 1) / 2 + 2;
+    int maxy = 0, maxx = 0;
+    int y = 1;
+
+    getmaxyx(stdscr, maxy, maxx);
+    if (height > maxy - 4)
+        height = maxy - 4;
+
+    if (stats_win && (getmaxy(stats_win) != height || getbegx(stats_win) != maxx - D_STATS_WIDTH - 1)) {
+        delwin(stats_win);
+        stats_win = NULL;
+        touchwin(stdscr);
+    }
+
+    if (height < 3 || maxx < D_STATS_WIDTH + 2)
+        return;
+
+    if (!stats_win) {
+        stats_win = newwin(height, D_STATS_WIDTH, 3, maxx - D_STATS_WIDTH - 1);
+        if (!stats_win)
+            return;
+    }
+
+    werase(stats_win);
+    box(stats_win, 0, 0);
+    wattron(stats_win, A_BOLD | A_UNDERLINE);
+    mvwaddstr(stats_win, 0, (D_STATS_WIDTH - 10) / 2, "Statistics");
+    wattroff(stats_win, A_BOLD | A_UNDERLINE);
+
+    for (int i = 0; i < STATS_MAX_LATENCY; i++)
+        display_stats_latency(y++, latencies[i], &st->latency[i]);
+
+    mvwprintw(stats_win, y++, 1, "%-9s", "Latency");
+    for (int i = 0; i < SM_STATS_DECADES; i++)
+        wprintw(stats_win, " %6s", decades[i]);
+    for (int i = 0; i < STATS_MAX_LATENCY; i++)
+        display_stats_decades(y++, latencies[i], &st->latency[i]);
+
+    display_bytes(written, sizeof(written), st->tty_bytes, false);
+    display_bytes(rate, sizeof(rate), st->tty_rate, false);
+    display_bytes(rss, sizeof(rss), st->rss, false);
+    mvwprintw(stats_win, y++, 1, "%-9s %s written, %s/s", "Terminal", written, rate);
+    mvwprintw(stats_win, y++, 1, "%-9s %llu received, %llu dropped", "Signals",
+              (unsigned long long)st->signals, (unsigned long long)st->dropped);
+    mvwprintw(stats_win, y++, 1, "%-9s %s", "RSS", rss);
+
+    mvwaddstr(stats_win, y++, 1, "D-Bus calls per second");
+    for (int i = 0; i < st->n_methods && y < height - 1; i++) {
+        mvwprintw(stats_win, y, i % 2 ? 29 : 3, "%-17s %7.1f", st->methods[i].method, st->methods[i].rate);
+        if (i % 2)
+            y++;
+    }
+}
+
+/* Puts the popup on top of the list and sends the frame to the terminal */
+static void display_popup(void)
+{
+    if (popup_dirty) {
+        if (popup) {
+            delwin(popup);
+            popup = NULL;
+        }
+
+        /* The rows beneath the old popup are unchanged, paint them again */
+        touchwin(stdscr);
+
+        if (popup_text)
+            display_popup_build();
+        popup_dirty = false;
+    }
+
+    if (show_stats)
+        display_stats_build();
+
+    wnoutrefresh(stdscr);
+    if (stats_win) {
+        touchwin(stats_win);
+        wnoutrefresh(stats_win);
+    }
+    if (popup) {
+        touchwin(popup);
+        wnoutrefresh(popup);
+    }
+    doupdate();
+}
+
+/* Replace the text of the popup, it is drawn with the next frame */
+static void display_popup_set(const char *text, const char *title)
+{
+    free(popup_text);
+    free(popup_title);
+
+    popup_text = strdup(text);
+    popup_title = strdup(title);
+    if (!popup_text || !popup_title)
+        sm_err_set("Cannot allocate window text: %s\n", strerror(errno));
+
+    popup_dirty = true;
+    display_schedule_redraw();
+}
+
+/* Close the popup, and stop refreshing the unit it showed */
+static void display_popup_close(void)
+{
+    int rc;
+
+    if (status_svc) {
+        bus_fetch_service_status_cancel();
+        rc = sd_event_source_set_enabled(status_source, SD_EVENT_OFF);
+        if (rc < 0)
+            sm_err_set("Cannot stop status timer: %s\n", strerror(-rc));
+    }
+
+    status_svc = NULL;
+    status_bus = NULL;
+    journal_unfollow();
+    status_invocation_id[0] = '\0';
+
+    if (!popup_text)
+        return;
+
+    free(popup_text);
+    free(popup_title);
+    popup_text = NULL;
+    popup_title = NULL;
+
+    popup_dirty = true;
+    display_schedule_redraw();
+}
+
+/* Fetch the details of the status popup again in usec from now */
+static void display_status_arm(uint64_t usec)
+{
+    int rc;
+
+    rc = sd_event_source_set_time(status_source, usec + D_STATUS_USEC);
+    if (rc < 0)
+        sm_err_set("Cannot set status timer: %s\n", strerror(-rc));
+
+    rc = sd_event_source_set_enabled(status_source, SD_EVENT_ONESHOT);
+    if (rc < 0)
+        sm_err_set("Cannot enable status timer: %s\n", strerror(-rc));
+}
+
+/* Timer callback which refreshes the status popup while it is open */
+static int display_status_tick(sd_event_source *s, uint64_t usec, void *data)
+{
+    (void)s;
+    (void)data;
+
+    if (!status_svc)
+        return 0;
+
+    bus_fetch_service_status(status_bus, status_svc);
+    display_status_arm(usec);
+    return 0;
+}
+
+/* Take the statistics again in usec from now */
+static void display_stats_arm(uint64_t usec)
+{
+    int rc;
+
+    rc = sd_event_source_set_time(stats_source, usec + D_STATS_USEC);
+    if (rc < 0)
+        sm_err_set("Cannot set statistics timer: %s\n", strerror(-rc));
+
+    rc = sd_event_source_set_enabled(stats_source, SD_EVENT_ONESHOT);
+    if (rc < 0)
+        sm_err_set("Cannot enable statistics timer: %s\n", strerror(-rc));
+}
+
+/* Timer callback which updates the rates of the overlay while it is shown */
+static int display_stats_tick(sd_event_source *s, uint64_t usec, void *data)
+{
+    (void)s;
+    (void)data;
+
+    sm_stats_tick(usec);
+    display_stats_arm(usec);
+    display_schedule_redraw();
+    return 0;
+}
+
+/* Show or hide the performance overlay */
+static void display_stats_toggle(void)
+{
+    int rc;
+
+    show_stats = !show_stats;
+    if (show_stats) {
+        sm_stats_tick(service_now());
+        display_stats_arm(service_now());
+        return;
+    }
+
+    rc = sd_event_source_set_enabled(stats_source, SD_EVENT_OFF);
+    if (rc < 0)
+        sm_err_set("Cannot stop statistics timer: %s\n", strerror(-rc));
+
+    if (stats_win) {
+        delwin(stats_win);
+        stats_win = NULL;
+    }
+    touchwin(stdscr);
+}
+
+/* Format the text of the status popup from the unit details and its logs */
+static void display_status_format(void)
+{
+    char title[48] = "Status:";
+    char *status = NULL;
+    char *window = NULL;
+    const char *logs = NULL;
+    size_t len = 0;
+    int fit = getmaxy(stdscr) - 2;
+
+    /* Show as many log lines as fit below the details */
+    status = service_status_info(status_svc, NULL);
+    for (char *p = status; p && *p; p++) {
+        if (*p == '\n')
+            fit--;
+    }
+    free(status);
+
+    if (fit < 1)
+        fit = 1;
+    status_fit = fit;
+
+    /* The oldest page is as far back as the view goes */
+    if (status_scroll > journal_lines() - fit)
+        status_scroll = journal_lines() - fit;
+    if (status_scroll < 0)
+        status_scroll = 0;
+
+    logs = journal_logs(fit, status_scroll, &len);
+    if (logs) {
+        window = strndup(logs, len);
+        if (!window)
+            sm_err_set("Cannot allocate log lines: %s\n", strerror(errno));
+    }
+
+    if (status_scroll)
+        snprintf(title, sizeof(title), "Status: %d of %d log lines back", status_scroll, journal_lines());
+
+    status = service_status_info(status_svc, window);
+    display_popup_set(status ? status : "No status information available.", title);
+    free(window);
+    free(status);
+}
+
+/* Scroll the logs of the status popup, false if the key does not scroll */
+static bool display_status_scroll(int c)
+{
+    int scroll = status_scroll;
+
+    switch (c) {
+        case KEY_UP:
+            scroll++;
+            break;
+
+        case KEY_DOWN:
+            scroll--;
+            break;
+
+        case KEY_PPAGE:
+            scroll += status_fit;
+            break;
+
+        case KEY_NPAGE:
+            scroll -= status_fit;
+            break;
+
+        case KEY_HOME:
+            scroll = journal_lines();
+            break;
+
+        case KEY_END:
+            scroll = 0;
+            break;
+
+        default:
+            return false;
+    }
+
+    if (scroll > journal_lines() - status_fit)
+        scroll = journal_lines() - status_fit;
+    if (scroll < 0)
+        scroll = 0;
+
+    if (scroll != status_scroll) {
+        status_scroll = scroll;
+        display_status_format();
+    }
+
+    return true;
+}
+
+/**
+ * Opens the status popup for a unit.
+ *
+ * The details are fetched asynchronously, the popup appears once they are in
+ * and is kept up to date until it is closed.
+ *
+ * @param bus The bus the unit belongs to.
+ * @param svc The unit to show.
+ */
+static void display_status_open(Bus *bus, Service *svc)
+{
+    display_popup_close();
+
+    status_bus = bus;
+    status_svc = svc;
+    status_scroll = 0;
+    bus_fetch_service_status(bus, svc);
+    display_status_arm(service_now());
+}
 
 /**
  * Handles user input and performs various operations on systemd services.
@@ -187,14 +998,14 @@ static void display_text_and_lines(Bus *bus)
 int display_key_pressed(sd_event_source *s, int fd, uint32_t revents, void *data)
 {
     int c;
-    char *status = NULL;
     int max_services = 0;
     int page_scroll = getmaxy(stdscr) - 6;
-    bool update_state = false;
     int maxy = getmaxy(stdscr);
     Service *svc = NULL;
     Bus *bus = (Bus *)data;
 
+    (void)fd;
+
     if ((revents & (EPOLLHUP|EPOLLERR|EPOLLRDHUP)) > 0) 
         sm_err_set("Error handling input: %s\n", strerror(errno));
 
@@ -203,25 +1014,33 @@ int display_key_pressed(sd_event_source *s, int fd, uint32_t revents, void *data
         if (c == ERR)
             return 0;
 
-        max_services = bus->total_types[mode];
+        /* The logs of the status popup scroll, any other key closes the popup */
+        if (status_svc && popup_text && display_status_scroll(c))
+            continue;
+
+        if ((popup_text || status_svc) && c != KEY_RESIZE) {
+            display_popup_close();
+            continue;
+        }
+
+        if (searching && display_search_key(c)) {
+            display_anchor(bus);
+            display_schedule_redraw();
+            continue;
+        }
+
+        max_services = service_count(bus);
 
         switch(tolower(c)) {
             case KEY_UP:
                 if (position > 0)
                     position--;
-                else if (index_start > 0) {
+                else if (index_start > 0)
                     index_start--;
-                    erase();
-                }
                 break;
 
             case KEY_DOWN:
-                if (position < maxy - 6 && index_start + position < max_services - 1)
-                    position++;
-                else if (index_start + position < max_services - 1) {
-                    index_start++;
-                    erase();
-                }
+                display_cursor_down(max_services, maxy);
                 break;
 
             case KEY_PPAGE: // Page Up
@@ -229,7 +1048,6 @@ int display_key_pressed(sd_event_source *s, int fd, uint32_t revents, void *data
                     index_start -= page_scroll;
                     if (index_start < 0)
                         index_start = 0;
-                    erase();
                 }
 
                 position = 0;
@@ -239,7 +1057,6 @@ int display_key_pressed(sd_event_source *s, int fd, uint32_t revents, void *data
                 if (index_start < max_services - page_scroll) {
                     index_start += page_scroll;
                     position = maxy - 6;
-                    erase();
                 }
                 break;
 
@@ -259,19 +1076,13 @@ int display_key_pressed(sd_event_source *s, int fd, uint32_t revents, void *data
                 type ^= 0x1;
                 bus = bus_currently_displayed();
                 sd_event_source_set_userdata(s, bus);
-                erase();
                 break;
 
             case KEY_RETURN:
-                svc = service_ypos(bus, position + 4);
+                svc = display_selected(bus);
                 if (!svc)
                     break;
-                if(position < 0)
-                    break;
-                status = service_status_info(bus, svc);
-
-                display_status_window(status ? status : "No status information available.", "Status:");
-                free(status);
+                display_status_open(bus, svc);
                 break;
 
             case KEY_F(1):
@@ -288,28 +1099,28 @@ int display_key_pressed(sd_event_source *s, int fd, uint32_t revents, void *data
 
             case KEY_F(4):
                 D_OP(bus, svc, ENABLE, "Enable");
-                update_state = true;
                 break;
 
             case KEY_F(5):
                 D_OP(bus, svc, DISABLE, "Disable");
-                update_state = true;
                 break;
 
             case KEY_F(6):
                 D_OP(bus, svc, MASK, "Mask");
-                update_state = true;
                 break;
 
             case KEY_F(7):
                 D_OP(bus, svc, UNMASK, "Unmask");
-                update_state = true;
                 break;
 
             case KEY_F(8):
                 D_OP(bus, svc, RELOAD, "Reload");
                 break;
 
+            case KEY_F(12):
+                display_stats_toggle();
+                break;
+
             case 'a':
                 D_MODE(ALL);
                 break;
@@ -362,12 +1173,58 @@ int display_key_pressed(sd_event_source *s, int fd, uint32_t revents, void *data
                 D_MODE(SNAPSHOT);
                 break;
 
+            case 'u':
+                show_usage = !show_usage;
+                cgroup_set_enabled(show_usage || sort != SORT_NAME);
+                display_invalidate();
+                break;
+
+            case 'x':
+            case KEY_IC:
+                svc = display_selected(bus);
+                if (!svc)
+                    break;
+                service_mark(bus, svc, !svc->marked);
+                display_cursor_down(max_services, maxy);
+                break;
+
+            case '*':
+                display_mark_listed(bus);
+                break;
+
+            case '-':
+                display_unmark(bus);
+                break;
+
+            case '/':
+                searching = true;
+                search[0] = '\0';
+                position = 0;
+                index_start = 0;
+                break;
+
+            case KEY_TAB:
+                sort = (sort + 1) % MAX_SORTS;
+                cgroup_set_enabled(show_usage || sort != SORT_NAME);
+                break;
+
             case KEY_ESC:
+                /* The first escape drops the search */
+                if (search[0]) {
+                    search[0] = '\0';
+                    position = 0;
+                    index_start = 0;
+                    break;
+                }
                 if ((service_now() - start_time) < D_ESCOFF_MS) 
                     break;
                 endwin();
                 exit(EXIT_SUCCESS);
 
+            case KEY_RESIZE:
+                display_invalidate();
+                break;
+
             case 'q':
                 endwin();
                 exit(EXIT_SUCCESS);
@@ -377,15 +1234,6 @@ int display_key_pressed(sd_event_source *s, int fd, uint32_t revents, void *data
                 continue;
         }
 
-        if (update_state)
-            bus_update_unit_file_state(bus, svc);
-
-        /* redraw any lines we have invalidated */
-        if (update_state) {
-            display_redraw_row(svc);
-            svc->changed = 0;
-        }
-
         if(index_start < 0)
             index_start = 0;
 
@@ -402,12 +1250,24 @@ int display_key_pressed(sd_event_source *s, int fd, uint32_t revents, void *data
             }
         }
 
-        display_redraw(bus);
+        display_anchor(bus);
+        display_schedule_redraw();
     }
 
     return 0;
 }
 
+/* Timer callback which renders a scheduled frame */
+static int display_frame(sd_event_source *s, uint64_t usec, void *data)
+{
+    (void)s;
+    (void)usec;
+    (void)data;
+
+    display_redraw(bus_currently_displayed());
+    return 0;
+}
+
 
 enum bus_type display_bus_type(void)
 {
@@ -419,41 +1279,94 @@ enum service_type display_mode(void)
     return mode;
 }
 
+enum service_sort display_sort(void)
+{
+    return sort;
+}
+
+/* The search the list is filtered by, or NULL if there is none */
+const char * display_search(void)
+{
+    return search[0] ? search : NULL;
+}
+
 void display_redraw(Bus *bus)
 {
+    uint64_t written = sm_stats_written();
+    uint64_t started = sm_stats_now();
+
+    last_frame = service_now();
+
+    display_follow_anchor(bus);
     display_services(bus);
-    clrtobot();
-    display_text_and_lines(bus);
-    refresh();
+    if (repaint)
+        display_text_and_lines();
+    display_header(bus);
+    display_search_prompt();
+    display_popup();
+
+    /* What the frame sent to the terminal, nothing else writes while it is drawn */
+    sm_stats_tty(sm_stats_written() - written);
+    sm_stats_latency(STATS_FRAME, sm_stats_now() - started);
 }
 
 /**
- * Refreshes the display row for the given service.
- *
- * If the service is currently displayed on the screen, this function will
- * clear the row for the service and redraw it to ensure the display is
- * up-to-date.
+ * Marks the screen dirty and arranges for it to be redrawn.
  *
- * @param svc The service to refresh the display row for.
+ * The frame is rendered from the event loop no sooner than one frame interval
+ * after the previous one, so any number of calls in between cost one redraw.
  */
-void display_redraw_row(Service *svc)
+void display_schedule_redraw(void)
 {
-    /* If the service is on the screen, invalidate the row so it refreshes
-     * correctly */
-    int x, y;
+    int enabled = SD_EVENT_OFF;
+    uint64_t next;
+    int rc;
+
+    if (!frame_source)
+        return;
+
+    rc = sd_event_source_get_enabled(frame_source, &enabled);
+    if (rc < 0)
+        sm_err_set("Cannot query frame timer: %s\n", strerror(-rc));
 
-    if (svc->ypos < 0)
+    /* A frame is already due */
+    if (enabled != SD_EVENT_OFF)
         return;
 
-    getyx(stdscr, y, x);
-    wmove(stdscr, svc->ypos, D_XLOAD);
-    wclrtoeol(stdscr);
-    wmove(stdscr, y, x);
+    next = last_frame + frame_interval;
+    if (next < service_now())
+        next = service_now();
+
+    rc = sd_event_source_set_time(frame_source, next);
+    if (rc < 0)
+        sm_err_set("Cannot set frame timer: %s\n", strerror(-rc));
+
+    rc = sd_event_source_set_enabled(frame_source, SD_EVENT_ONESHOT);
+    if (rc < 0)
+        sm_err_set("Cannot enable frame timer: %s\n", strerror(-rc));
 }
 
-void display_erase(void)
+/* Return the list row the service is shown on, or -1 if it is not on the screen */
+int display_service_row(Service *svc)
 {
-    erase();
+    for (int i = 0; i < nrows; i++) {
+        if (rows[i] == svc)
+            return i;
+    }
+
+    return -1;
+}
+
+/* A service is about to be freed, make sure no row still refers to it */
+void display_forget_service(Service *svc)
+{
+    int row = display_service_row(svc);
+
+    if (row > -1)
+        rows[row] = NULL;
+
+    if (svc == status_svc)
+        display_popup_close();
 }
 
 void display_set_bus_type(enum bus_type ty)
@@ -461,6 +1374,15 @@ void display_set_bus_type(enum bus_type ty)
     type = ty; 
 }
 
+/* Cap the number of frames rendered per second */
+void display_set_fps(int fps)
+{
+    if (fps < 1)
+        fps = 1;
+
+    frame_interval = 1000000 / fps;
+}
+
 void display_init(void)
 {
     int rc = -1;
@@ -480,6 +1402,51 @@ void display_init(void)
     if (rc < 0)
         sm_err_set("Cannot initialize event handler: %s\n", strerror(-rc));
 
+    /* The frame timer stays off until a redraw is scheduled */
+    rc = sd_event_add_time(ev,
+                           &frame_source,
+                           CLOCK_MONOTONIC,
+                           0,
+                           1000,
+                           display_frame,
+                           NULL);
+    if (rc < 0)
+        sm_err_set("Cannot initialize frame timer: %s\n", strerror(-rc));
+
+    rc = sd_event_source_set_enabled(frame_source, SD_EVENT_OFF);
+    if (rc < 0)
+        sm_err_set("Cannot initialize frame timer: %s\n", strerror(-rc));
+
+    /* Refreshes the status popup, armed while it is open */
+    rc = sd_event_add_time(ev,
+                           &status_source,
+                           CLOCK_MONOTONIC,
+                           0,
+                           1000,
+                           display_status_tick,
+                           NULL);
+    if (rc < 0)
+        sm_err_set("Cannot initialize status timer: %s\n", strerror(-rc));
+
+    rc = sd_event_source_set_enabled(status_source, SD_EVENT_OFF);
+    if (rc < 0)
+        sm_err_set("Cannot initialize status timer: %s\n", strerror(-rc));
+
+    /* Updates the rates of the performance overlay, armed while it is shown */
+    rc = sd_event_add_time(ev,
+                           &stats_source,
+                           CLOCK_MONOTONIC,
+                           0,
+                           1000,
+                           display_stats_tick,
+                           NULL);
+    if (rc < 0)
+        sm_err_set("Cannot initialize statistics timer: %s\n", strerror(-rc));
+
+    rc = sd_event_source_set_enabled(stats_source, SD_EVENT_OFF);
+    if (rc < 0)
+        sm_err_set("Cannot initialize statistics timer: %s\n", strerror(-rc));
+
     euid = geteuid();
 
     start_time = service_now();
@@ -491,6 +1458,8 @@ void display_init(void)
     keypad(stdscr, TRUE);
     nodelay(stdscr, TRUE);
     set_escdelay(0);
+    /* Let curses scroll the terminal instead of repainting shifted rows */
+    idlok(stdscr, TRUE);
     start_color();
 
     init_pair(0, COLOR_BLACK, COLOR_WHITE);
@@ -506,6 +1475,7 @@ void display_init(void)
     init_pair(10, COLOR_BLACK, COLOR_GREEN);
     init_pair(11, COLOR_RED, COLOR_YELLOW);
     init_pair(12, COLOR_RED, COLOR_BLUE);
+    init_pair(13, COLOR_RED, COLOR_BLACK);
 
     clear();
     border(0, 0, 0, 0, 0, 0, 0, 0);
@@ -514,94 +1484,65 @@ void display_init(void)
 /**
  * Displays a status window with the provided status message and title.
  *
- * This function creates a centered window on the screen with the given status
- * message and title. The window is displayed until the user presses a key.
+ * The window is centered on top of the list and stays until the user presses
+ * a key. This does not block, the window is drawn by the next frame.
  *
  * @param status The status message to display in the window.
  * @param title The title to display at the top of the window.
  */
-void display_status_window(const char *status, const char *title) {
-    char status_cpy[strlen(status) + 1];
-    strcpy(status_cpy, status);
-    int maxx_row = 0, maxy = 0, maxx = 0;
-    int current_row_length = 0;
-    int rows = 0, height = 0, width=0;
-    int startx = 0, starty = 0;
-    WINDOW *win = NULL;
-    int text_starty, y, x;
-    int line_length = 0;
-    const char *line_start = NULL;
-    const char *line_end = NULL;
+void display_status_window(const char *status, const char *title)
+{
+    display_popup_close();
+    display_popup_set(status, title);
+}
 
-    strcpy(status_cpy, status);
+/**
+ * Called when the details of a unit were fetched. If the unit is shown in the
+ * status popup, its text is formatted again.
+ *
+ * @param svc The unit whose details were updated.
+ */
+void display_status_update(Service *svc)
+{
+    if (svc != status_svc)
+        return;
 
-    for (int count = 0; status_cpy[count] != '\0'; count++) {
-        if (status_cpy[count] == '\n') {
-            rows++;
-            if (current_row_length > maxx_row)
-                maxx_row = current_row_length;
-            current_row_length = 0;
-        }
-        else
-            current_row_length++;
+    /* The logs belong to an invocation, follow the new one when it changes */
+    if (strcmp(status_invocation_id, service_detail(svc)->invocation_id)) {
+        journal_follow(svc);
+        strcpy(status_invocation_id, svc->detail->invocation_id);
     }
 
-    if(current_row_length > maxx_row)
-        maxx_row = current_row_length;
-
-    getmaxyx(stdscr, maxy, maxx);
-
-    if(rows >= maxy)
-        height = maxy + 2;
-    else
-        height = rows + 2;
-    if(rows == 0)
-        height = 3;
-
-    if(maxx_row >= maxx)
-        width = maxx;
-    else
-        width = maxx_row + 4;
-
-    starty = (maxy - height) / 2;
-    startx = (maxx - width) / 2;
-
-    win = newwin(height, width, starty, startx);
-    box(win, 0, 0);
-    keypad(win, TRUE);
-    start_color();
-    init_pair(13, COLOR_RED, COLOR_BLACK);
-
-    text_starty = 1;
-    y = text_starty;
-    x = 1;
-
-    wattron(win, A_BOLD);
-    wattron(win, A_UNDERLINE);
-
-    mvwprintw(win, 0, (width / 2) - (strlen(title) / 2), "%s", title);
-    wattroff(win, A_UNDERLINE);
+    display_status_format();
+}
 
-    if(rows == 0)
-        wattron(win, COLOR_PAIR(13));
+/* The details of the unit in the status popup could not be fetched */
+void display_status_failed(Service *svc, const char *message)
+{
+    char text[256];
 
-    line_start = status_cpy;
-    while ((line_end = strchr(line_start, '\n')) != NULL) {
-        line_length = line_end - line_start;
-        if (line_length > width - 2)
-            line_length = width - 6;
+    if (svc != status_svc)
+        return;
 
-        mvwaddnstr(win, y++, x, line_start, line_length);
-        line_start = line_end + 1;
-    }
+    snprintf(text, sizeof(text), "Cannot fetch unit properties: %s", message);
+    display_popup_set(text, "Status:");
+}
 
-    mvwprintw(win, y, x, "%s", line_start);
-    wrefresh(win);
-    wgetch(win);
+/* New log lines of the unit in the status popup arrived. A view scrolled
+ * back stays on the lines it shows. */
+void display_status_logs(int added)
+{
+    if (!status_svc)
+        return;
 
-    wattroff(win, COLOR_PAIR(13));
-    wattroff(win, A_BOLD);
+    if (status_scroll)
+        status_scroll += added;
+    display_status_format();
+}
 
-    delwin(win);
-    refresh();
+/* A property of a unit changed, refresh it if it is shown in the status popup */
+void display_status_refresh(Service *svc)
+{
+    if (svc == status_svc)
+        bus_fetch_service_status(status_bus, svc);
 }
@@ -5,10 +5,15 @@
 #include "bus.h"
 
 #define KEY_RETURN 10
+#define KEY_TAB 9
 #define KEY_ESC 27
 #define KEY_SPACE 32
+#define KEY_DEL 127
 
 #define D_ESCOFF_MS      300000LLU
+#define D_FPS            30
+#define D_STATUS_USEC    1000000LLU
+#define D_STATS_USEC     1000000LLU
 #define D_VERSION        "1.4.1"
 #define D_FUNCTIONS      "F1:START F2:STOP F3:RESTART F4:ENABLE F5:DISABLE F6:MASK F7:UNMASK F8:RELOAD"
 #define D_SERVICE_TYPES  "A:ALL D:DEV I:SLICE S:SERVICE O:SOCKET T:TARGET R:TIMER M:MOUNT C:SCOPE N:AMOUNT W:SWAP P:PATH H:SSHOT"
@@ -19,11 +24,17 @@
 #define D_XSUB 124
 #define D_XDESCRIPTION 134
 
+#define D_NFIELDS 5
+#define D_NHEADER 6
+
+/* Size of the performance overlay, without the rows of D-Bus methods */
+#define D_STATS_WIDTH 62
+#define D_STATS_ROWS 11
+
 #define D_MODE(m) {\
     position = 0;\
     index_start = 0;\
     mode = m;\
-    clear();\
 }
 
 #define D_OP(bus, svc, mode, txt) {\
@@ -32,18 +43,31 @@
         display_status_window(" You must be root for this operation on system units. Press space to toggle: System/User.", "info:");\
         break;\
     }\
-    svc = service_ypos(bus, position + 4);\
-    success = bus_operation(bus, svc, mode);\
+    svc = display_selected(bus);\
+    if (bus->n_marked)\
+        success = bus_operation_marked(bus, mode);\
+    else if (svc)\
+        success = bus_operation(bus, svc, mode);\
+    else\
+        break;\
     if (!success)\
         display_status_window("Command could not be executed on this unit.", txt":");\
 }
 
 enum bus_type display_bus_type(void);
 enum service_type display_mode(void);
-void display_erase(void);
+enum service_sort display_sort(void);
+const char * display_search(void);
+int display_service_row(Service *svc);
+void display_forget_service(Service *svc);
 void display_init(void);
 void display_redraw(Bus *bus);
-void display_redraw_row(Service *svc);
+void display_schedule_redraw(void);
 void display_set_bus_type(enum bus_type);
+void display_set_fps(int fps);
+void display_status_logs(int added);
+void display_status_refresh(Service *svc);
+void display_status_update(Service *svc);
+void display_status_failed(Service *svc, const char *message);
 void display_status_window(const char *status, const char *title);
 #endif
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sm_err.h"
+#include "bus.h"
+#include "dump.h"
+
+/* The columns of a dump, in the order they are written */
+static const char *dump_columns[] = {
+    "bus",
+    "unit",
+    "load",
+    "active",
+    "sub",
+    "unit_file_state",
+    "description"
+};
+
+#define DUMP_NCOLUMNS (sizeof(dump_columns) / sizeof(dump_columns[0]))
+
+struct dump_state {
+    enum dump_format format;
+    unsigned rows;
+};
+
+/* Write a JSON string, quoted and escaped */
+static void dump_json_string(const char *s)
+{
+    putchar('"');
+    for (; *s; s++) {
+        switch (*s) {
+            case '"':
+                fputs("\\\"", stdout);
+                break;
+            case '\\':
+                fputs("\\\\", stdout);
+                break;
+            case '\n':
+                fputs("\\n", stdout);
+                break;
+            case '\t':
+                fputs("\\t", stdout);
+                break;
+            default:
+                if ((unsigned char)*s < 0x20)
+                    printf("\\u%04x", (unsigned char)*s);
+                else
+                    putchar(*s);
+        }
+    }
+    putchar('"');
+}
+
+/* Write a TSV field, tabs and line breaks in it are escaped */
+static void dump_tsv_field(const char *s)
+{
+    for (; *s; s++) {
+        switch (*s) {
+            case '\\':
+                fputs("\\\\", stdout);
+                break;
+            case '\t':
+                fputs("\\t", stdout);
+                break;
+            case '\n':
+                fputs("\\n", stdout);
+                break;
+            case '\r':
+                fputs("\\r", stdout);
+                break;
+            default:
+                putchar(*s);
+        }
+    }
+}
+
+/* Callback which writes a unit as soon as the bus lists it */
+static void dump_unit(const struct bus_unit *u, void *data)
+{
+    struct dump_state *st = (struct dump_state *)data;
+    const char *fields[DUMP_NCOLUMNS] = {
+        u->type == SYSTEM ? "system" : "user",
+        u->unit,
+        u->load,
+        u->active,
+        u->sub,
+        u->unit_file_state,
+        u->description
+    };
+
+    for (size_t i = 0; i < DUMP_NCOLUMNS; i++) {
+        if (st->format == DUMP_TSV) {
+            if (i)
+                putchar('\t');
+            dump_tsv_field(fields[i]);
+            continue;
+        }
+
+        fputs(i ? "," : (st->rows ? ",\n{" : "{"), stdout);
+        dump_json_string(dump_columns[i]);
+        putchar(':');
+        dump_json_string(fields[i]);
+    }
+
+    fputs(st->format == DUMP_TSV ? "\n" : "}", stdout);
+    st->rows++;
+}
+
+/* Map the argument of --dump to a format, DUMP_NONE if it is unknown */
+enum dump_format dump_parse_format(const char *name)
+{
+    if (!name || strcmp(name, "json") == 0)
+        return DUMP_JSON;
+    if (strcmp(name, "tsv") == 0)
+        return DUMP_TSV;
+
+    return DUMP_NONE;
+}
+
+/**
+ * Writes the units of the system and the user bus to stdout.
+ *
+ * JSON is an array with an object per unit, TSV a header line and a line per
+ * unit. Units are written as they are read from the bus, nothing is kept.
+ * The terminal is not touched, so this can run from scripts.
+ *
+ * @param format The output format.
+ */
+void dump_units(enum dump_format format)
+{
+    struct dump_state st = { .format = format };
+
+    if (format == DUMP_TSV) {
+        for (size_t i = 0; i < DUMP_NCOLUMNS; i++)
+            printf("%s%s", i ? "\t" : "", dump_columns[i]);
+        putchar('\n');
+    }
+    else
+        fputs("[\n", stdout);
+
+    bus_dump_units(SYSTEM, dump_unit, &st);
+
+    /* Without a user session there is only the system bus */
+    bus_dump_units(USER, dump_unit, &st);
+
+    if (format == DUMP_JSON)
+        fputs(st.rows ? "\n]\n" : "]\n", stdout);
+
+    if (fflush(stdout) == EOF || ferror(stdout))
+        sm_err_set("Cannot write units: %s", strerror(errno));
+}
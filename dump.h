@@ -0,0 +1,13 @@
+#ifndef _DUMP_H_
+#define _DUMP_H_
+
+/* Output formats of --dump */
+enum dump_format {
+    DUMP_NONE,
+    DUMP_JSON,
+    DUMP_TSV
+};
+
+enum dump_format dump_parse_format(const char *name);
+void dump_units(enum dump_format format);
+#endif
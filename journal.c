@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <systemd/sd-event.h>
+#include <systemd/sd-journal.h>
+#include "sm_err.h"
+#include "display.h"
+#include "journal.h"
+#include "sm_stats.h"
+
+/* The journal is followed for one unit at a time, like journalctl -fu */
+static sd_journal *journal = NULL;
+static sd_event_source *journal_source = NULL;
+
+/* The formatted log lines, at most max_lines of them. Lines dropped from the
+ * front only move logs_start, the buffer is compacted when it has to grow. */
+static char *logs = NULL;
+static size_t logs_start = 0;
+static size_t logs_len = 0;
+static size_t logs_size = 0;
+static int nlines = 0;
+static int max_lines = JOURNAL_LINES;
+
+/* The fields shown for an entry, they are picked out in one pass over its data */
+enum journal_fields {
+    FIELD_MESSAGE,
+    FIELD_HOSTNAME,
+    FIELD_IDENTIFIER,
+    FIELD_PID,
+    MAX_FIELDS
+};
+
+static const char *journal_field_names[MAX_FIELDS] = {
+    "MESSAGE=",
+    "_HOSTNAME=",
+    "SYSLOG_IDENTIFIER=",
+    "_PID="
+};
+
+/**
+ * Picks the shown fields out of the current journal entry.
+ *
+ * The values point into the journal and are not NUL terminated. Fields the
+ * entry lacks are "".
+ *
+ * @param values Receives the value of each field.
+ * @param lens Receives the length of each value.
+ */
+static void journal_fields(const char **values, int *lens)
+{
+    const char *data = NULL;
+    size_t sz = 0;
+    int found = 0;
+
+    for (int i = 0; i < MAX_FIELDS; i++) {
+        values[i] = "";
+        lens[i] = 0;
+    }
+
+    sd_journal_restart_data(journal);
+    while (found < MAX_FIELDS && sd_journal_enumerate_available_data(journal, (const void **)&data, &sz) > 0) {
+        for (int i = 0; i < MAX_FIELDS; i++) {
+            size_t flen = strlen(journal_field_names[i]);
+
+            if (sz < flen || memcmp(data, journal_field_names[i], flen))
+                continue;
+
+            values[i] = data + flen;
+            lens[i] = sz - flen;
+            found++;
+            break;
+        }
+    }
+}
+
+/* Make room for need more bytes at the end of the logs */
+static void journal_reserve(size_t need)
+{
+    char *l;
+
+    if (logs_len + need <= logs_size)
+        return;
+
+    /* Reuse the space of dropped lines before growing */
+    if (logs_start > 0) {
+        memmove(logs, logs + logs_start, logs_len - logs_start + 1);
+        logs_len -= logs_start;
+        logs_start = 0;
+
+        if (logs_len + need <= logs_size)
+            return;
+    }
+
+    logs_size = (logs_len + need) * 2;
+    l = realloc(logs, logs_size);
+    if (!l)
+        sm_err_set("Cannot create logs: %s", strerror(errno));
+    logs = l;
+}
+
+/* Drop the oldest lines so no more than max_lines are kept */
+static void journal_trim(void)
+{
+    char *nl;
+
+    while (nlines > max_lines) {
+        nl = memchr(logs + logs_start, '\n', logs_len - logs_start);
+        if (!nl)
+            break;
+
+        logs_start = nl - logs + 1;
+        nlines--;
+    }
+}
+
+/* Format the current journal entry and append it to the logs */
+static void journal_append(void)
+{
+    const char *values[MAX_FIELDS];
+    int lens[MAX_FIELDS];
+    char strstamp[32] = {0};
+    uint64_t stamp = 0;
+    size_t need;
+    time_t t;
+    int written;
+
+    if (sd_journal_get_realtime_usec(journal, &stamp) < 0)
+        return;
+
+    journal_fields(values, lens);
+
+    t = stamp / 1000000;
+    strftime(strstamp, sizeof(strstamp), "%b %d %H:%M:%S", localtime(&t));
+
+    /* The 8 is for the separators, newline and terminator */
+    need = strlen(strstamp) + 8;
+    for (int i = 0; i < MAX_FIELDS; i++)
+        need += lens[i];
+    journal_reserve(need);
+
+    written = snprintf(logs + logs_len, logs_size - logs_len, "%s %.*s %.*s[%.*s]: %.*s\n",
+                       strstamp,
+                       lens[FIELD_HOSTNAME], values[FIELD_HOSTNAME],
+                       lens[FIELD_IDENTIFIER], values[FIELD_IDENTIFIER],
+                       lens[FIELD_PID], values[FIELD_PID],
+                       lens[FIELD_MESSAGE], values[FIELD_MESSAGE]);
+    if (written < 0)
+        sm_err_set("Failed to write logs");
+
+    /* Keep one entry per line, a multi-line message is joined with spaces */
+    for (char *p = logs + logs_len; p < logs + logs_len + written - 1; p++)
+        if (*p == '\n' || *p == '\r')
+            *p = ' ';
+
+    logs_len += written;
+    nlines++;
+    journal_trim();
+}
+
+/* Append every entry after the current read position */
+static int journal_read_new(void)
+{
+    uint64_t start = sm_stats_now();
+    int appended = 0;
+    int rc;
+
+    while ((rc = sd_journal_next(journal)) > 0) {
+        journal_append();
+        appended++;
+    }
+
+    if (rc < 0)
+        sm_err_set("Cannot read journal: %s", strerror(-rc));
+
+    sm_stats_latency(STATS_JOURNAL, sm_stats_now() - start);
+    return appended;
+}
+
+/**
+ * Callback for the journal file descriptor. New entries for the followed
+ * unit are appended to the logs and the status window is updated.
+ *
+ * @param s The event source that triggered the callback.
+ * @param fd The journal file descriptor.
+ * @param revents The events that occurred on the file descriptor.
+ * @param data Unused.
+ * @return 0 to indicate the event was handled successfully.
+ */
+static int journal_changed(sd_event_source *s, int fd, uint32_t revents, void *data)
+{
+    int added;
+    int rc;
+
+    (void)s;
+    (void)fd;
+    (void)revents;
+    (void)data;
+
+    rc = sd_journal_process(journal);
+    if (rc < 0)
+        sm_err_set("Cannot process journal changes: %s", strerror(-rc));
+
+    if (rc == SD_JOURNAL_NOP)
+        return 0;
+
+    added = journal_read_new();
+    if (added > 0)
+        display_status_logs(added);
+
+    return 0;
+}
+
+/**
+ * Starts following the journal of a unit invocation.
+ *
+ * The last lines already in the journal are read once, then new entries are
+ * appended as the journal reports them, without reopening or re-reading it.
+ * Any unit followed before is dropped.
+ *
+ * @param svc The unit to follow, its invocation ID must be known.
+ */
+void journal_follow(Service *svc)
+{
+    char match[64] = {0};
+    sd_event *ev = NULL;
+    int rc;
+
+    journal_unfollow();
+
+    rc = sd_journal_open(&journal, SD_JOURNAL_SYSTEM | SD_JOURNAL_CURRENT_USER);
+    if (rc < 0)
+        sm_err_set("Cannot retrieve journal: %s", strerror(-rc));
+
+    rc = sd_journal_set_data_threshold(journal, JOURNAL_DATA_MAX);
+    if (rc < 0)
+        sm_err_set("Cannot set journal data threshold: %s", strerror(-rc));
+
+    snprintf(match, sizeof(match), "_SYSTEMD_INVOCATION_ID=%s", svc->detail->invocation_id);
+    sd_journal_add_match(journal, match, 0);
+
+    sd_journal_add_disjunction(journal);
+    snprintf(match, sizeof(match), "USER_INVOCATION_ID=%s", svc->detail->invocation_id);
+    sd_journal_add_match(journal, match, 0);
+
+    /* Position before the last lines, reading forward appends them in order */
+    rc = sd_journal_seek_tail(journal);
+    if (rc < 0)
+        sm_err_set("Cannot seek journal: %s", strerror(-rc));
+
+    rc = sd_journal_previous_skip(journal, max_lines + 1);
+    if (rc < 0)
+        sm_err_set("Cannot seek journal: %s", strerror(-rc));
+
+    /* Fewer entries than lines, start from the first one */
+    if (rc <= max_lines)
+        sd_journal_seek_head(journal);
+
+    journal_read_new();
+
+    rc = sd_event_default(&ev);
+    if (rc < 0)
+        sm_err_set("Cannot initialize event loop: %s\n", strerror(-rc));
+
+    rc = sd_journal_get_fd(journal);
+    if (rc < 0)
+        sm_err_set("Cannot watch journal: %s", strerror(-rc));
+
+    rc = sd_event_add_io(ev,
+                         &journal_source,
+                         rc,
+                         sd_journal_get_events(journal),
+                         journal_changed,
+                         NULL);
+    if (rc < 0)
+        sm_err_set("Cannot watch journal: %s", strerror(-rc));
+
+    sd_event_unref(ev);
+}
+
+/* Stop following the journal and forget the logs */
+void journal_unfollow(void)
+{
+    journal_source = sd_event_source_unref(journal_source);
+
+    if (journal)
+        sd_journal_close(journal);
+    journal = NULL;
+
+    free(logs);
+    logs = NULL;
+    logs_start = 0;
+    logs_len = 0;
+    logs_size = 0;
+    nlines = 0;
+}
+
+/* Set the number of log lines to keep, takes effect with the next unit followed */
+void journal_set_lines(int lines)
+{
+    max_lines = lines;
+}
+
+/* Start of the nth kept line, the oldest is 0. The walk starts from the nearer end. */
+static const char * journal_line(int n)
+{
+    const char *p;
+
+    if (n >= nlines)
+        return logs + logs_len;
+
+    if (n <= nlines / 2) {
+        for (p = logs + logs_start; n > 0 && p; n--) {
+            p = memchr(p, '\n', logs + logs_len - p);
+            if (p)
+                p++;
+        }
+        return p ? p : logs + logs_len;
+    }
+
+    /* Walk back from the trailing newline, counting line starts */
+    n = nlines - n;
+    for (p = logs + logs_len - 1; p > logs + logs_start; p--) {
+        if (p[-1] == '\n' && --n == 0)
+            return p;
+    }
+
+    return logs + logs_start;
+}
+
+/* Number of log lines kept for the followed unit */
+int journal_lines(void)
+{
+    return nlines;
+}
+
+/**
+ * Returns log lines of the followed unit, the newest ones unless the view
+ * is scrolled back.
+ *
+ * @param lines The number of lines wanted, or 0 for all that are kept.
+ * @param skip The number of newest lines left out, at least one line is
+ *        always returned.
+ * @param len Receives the length of the lines, they are not NUL terminated
+ *        unless they end with the newest line.
+ * @return The first of the lines, or NULL if there are none.
+ */
+const char * journal_logs(int lines, int skip, size_t *len)
+{
+    const char *start;
+    int from;
+
+    *len = 0;
+    if (logs_len == logs_start)
+        return NULL;
+
+    if (skip > nlines - 1)
+        skip = nlines - 1;
+    if (skip < 0)
+        skip = 0;
+    if (lines <= 0 || lines > nlines - skip)
+        lines = nlines - skip;
+
+    from = nlines - skip - lines;
+    start = journal_line(from);
+    *len = journal_line(from + lines) - start;
+    return start;
+}
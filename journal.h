@@ -0,0 +1,16 @@
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+#include "service.h"
+
+/* Default number of log lines kept for the unit shown in the status window */
+#define JOURNAL_LINES 10
+
+/* Longest field value read from an entry, longer messages are cut */
+#define JOURNAL_DATA_MAX 2048
+
+const char * journal_logs(int lines, int skip, size_t *len);
+int journal_lines(void);
+void journal_follow(Service *svc);
+void journal_set_lines(int lines);
+void journal_unfollow(void);
+#endif
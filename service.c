@@ -1,7 +1,8 @@
+#include <ctype.h>
+#include <stdio.h>
 #include "sm_err.h"
 #include "service.h"
 #include "display.h"
-#include <systemd/sd-journal.h>
 
 const char * service_str_types[] = {
     "all",
@@ -20,6 +21,15 @@ const char * service_str_types[] = {
     "__unknown__"
 };
 
+const char * service_str_sorts[] = {
+    "Name",
+    "CPU",
+    "Memory",
+    "Tasks",
+    "I/O",
+    "Restarts"
+};
+
 /* Using the the end of the units name, identify its service type */
 static void service_set_type(Service *svc)
 {
@@ -38,150 +48,221 @@ static void service_set_type(Service *svc)
     return;
 }
 
-static void service_free(Service *svc)
+/* Binary search for the first entry whose object path is not less than object */
+static int service_array_lower_bound(struct service_array *a, const char *object)
 {
-    if (!svc)
-        return;
+    int lo = 0, hi = a->len;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (strcmp(a->items[mid]->object, object) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
 
-    sd_bus_slot_unref(svc->slot);
-    free(svc->unit);
-    free(svc->load);
-    free(svc->active);
-    free(svc->sub);
-    free(svc->description);
-    free(svc->object);
-    free(svc->fragment_path);
-    free(svc->unit_file_state);
-    free(svc->cgroup);
-    free(svc->sysfs_path);
-    free(svc->mount_where);
-    free(svc->mount_what);
-    free(svc->bind_ipv6_only);
-    free(svc);
+    return lo;
 }
 
-/**
- * Retrieves the logs for a given service unit.
- *
- * @param svc The service unit to retrieve logs for.
- * @param lines The maximum number of log lines to retrieve.
- * @return A dynamically allocated string containing the formatted logs, or NULL on failure.
- */
-char *service_logs(Service *svc, int lines) {
-    sd_journal *j;
-    char *out = NULL;
-    char *ptr = NULL;
-    int r;
-    char match[256] = {0};
-    int total = 0;
-    int left = lines;
-    struct logline {
-        char msg[2048];
-        char hostname[128];
-        char syslogident[128];
-        char pid[10];
-        uint64_t stamp;
-    };
-
-    struct logline *logs = NULL;
-
-    logs = alloca(sizeof(struct logline) * lines);
-    memset(logs, 0, sizeof(*logs) * lines);
-
-    r = sd_journal_open(&j, SD_JOURNAL_SYSTEM | SD_JOURNAL_CURRENT_USER);
-    if (r < 0) {
-        sm_err_set("Cannot retrieve journal: %s", strerror(-r));
-        return NULL;
+/* Insert a service into a sorted array, returns the index it was placed at */
+static int service_array_insert(struct service_array *a, Service *svc)
+{
+    int idx;
+
+    if (a->len == a->cap) {
+        int cap = a->cap ? a->cap * 2 : 256;
+        Service **items = realloc(a->items, cap * sizeof(Service *));
+        if (!items)
+            sm_err_set("Cannot grow service index: %s", strerror(errno));
+        a->items = items;
+        a->cap = cap;
     }
 
-    snprintf(match, sizeof(match), "_SYSTEMD_INVOCATION_ID=%s", svc->invocation_id);
-    sd_journal_add_match(j, match, 0);
+    idx = service_array_lower_bound(a, svc->object);
+    memmove(&a->items[idx + 1], &a->items[idx], (a->len - idx) * sizeof(Service *));
+    a->items[idx] = svc;
+    a->len++;
 
-    sd_journal_add_disjunction(j);
-    snprintf(match, sizeof(match), "USER_INVOCATION_ID=%s", svc->invocation_id);
-    sd_journal_add_match(j, match, 0);
+    return idx;
+}
 
-    total = 0;
-    SD_JOURNAL_FOREACH_BACKWARDS(j) {
-        size_t sz;
-        const char *val = NULL;
+/* Drop every service not updated since ts from a sorted array in a single pass */
+static void service_array_prune(struct service_array *a, uint64_t ts)
+{
+    int n = 0;
 
-        if (left <= 0)
-            break;
+    for (int i = 0; i < a->len; i++) {
+        if (a->items[i]->last_update >= ts)
+            a->items[n++] = a->items[i];
+    }
 
-        struct logline *ll = &logs[left - 1];
+    a->len = n;
+}
 
-        r = sd_journal_get_realtime_usec(j, &ll->stamp);
-        if (r < 0)
-            continue;
+/* The value a unit is ordered by in a usage order, larger values come first */
+static uint64_t service_sort_value(Service *svc, enum service_sort sort)
+{
+    switch (sort) {
+        case SORT_CPU:
+            return svc->cpu_percent * 1000;
+        case SORT_MEMORY:
+            return svc->memory_current;
+        case SORT_TASKS:
+            return svc->tasks_current;
+        case SORT_IO:
+            return svc->io_rate;
+        case SORT_RESTARTS:
+            return svc->n_restarts;
+        default:
+            return 0;
+    }
+}
 
-        r = sd_journal_get_data(j, "MESSAGE", (const void **)&val, &sz);
-        if (r < 0)
-            continue;
-        strncpy(ll->msg, val + 8, sizeof(ll->msg) - 1);
-        ll->msg[sizeof(ll->msg) - 1] = '\0';  // Null termination
+/* Order by the cached sort value, ties keep the order of the object paths */
+static int service_usage_cmp(const void *a, const void *b)
+{
+    const Service *x = a;
+    const Service *y = b;
 
-        r = sd_journal_get_data(j, "_HOSTNAME", (const void **)&val, &sz);
-        if (r < 0)
-            continue;
-        strncpy(ll->hostname, val + 10, sizeof(ll->hostname) - 1);
-        ll->hostname[sizeof(ll->hostname) - 1] = '\0';
+    if (x->sort_value != y->sort_value)
+        return x->sort_value < y->sort_value ? 1 : -1;
 
-        r = sd_journal_get_data(j, "SYSLOG_IDENTIFIER", (const void **)&val, &sz);
-        if (r < 0)
-            continue;
-        strncpy(ll->syslogident, val + 18, sizeof(ll->syslogident) - 1);
-        ll->syslogident[sizeof(ll->syslogident) - 1] = '\0';
+    return strcmp(x->object, y->object);
+}
 
-        r = sd_journal_get_data(j, "_PID", (const void **)&val, &sz);
-        if (r < 0)
-            continue;
-        strncpy(ll->pid, val + 5, sizeof(ll->pid) - 1);
-        ll->pid[sizeof(ll->pid) - 1] = '\0';
+/* Link a unit into the usage orders of its bus at the place of its current value */
+static void service_usage_link(Bus *bus, Service *svc)
+{
+    svc->sort_value = service_sort_value(svc, bus->usage_sort);
 
-        /* The 64 is to over-compensate for writing in the timestamp and whitespace later */
-        total += strlen(ll->msg) + strlen(ll->hostname) + strlen(ll->syslogident) + strlen(ll->pid) + 64;
+    sm_tree_insert(&bus->by_usage[ALL], &svc->usage_node[0], svc);
+    if (svc->type != ALL)
+        sm_tree_insert(&bus->by_usage[svc->type], &svc->usage_node[1], svc);
+}
 
-        left--;
-    }
+/* Unlink a unit from the usage orders, it is found by its cached sort value */
+static void service_usage_unlink(Bus *bus, Service *svc)
+{
+    sm_tree_remove(&bus->by_usage[ALL], svc);
+    if (svc->type != ALL)
+        sm_tree_remove(&bus->by_usage[svc->type], svc);
+}
 
-    if (total == 0)
-        goto fin;
+/**
+ * Orders the usage trees of a bus by a sort key.
+ *
+ * Every unit is linked again, which only happens when the key changes. From
+ * then on units are moved one by one as their values change.
+ *
+ * @param bus The bus to order.
+ * @param sort The key to order by, SORT_NAME empties the trees.
+ */
+static void service_usage_order(Bus *bus, enum service_sort sort)
+{
+    struct service_array *all = &bus->by_type[ALL];
 
-    out = malloc(total + 1);  // +1 for Null termination
-    if (!out) {
-        sm_err_set("Cannot create logs: %s", strerror(errno));
-        goto fin;
+    if (bus->usage_sort == sort)
+        return;
+
+    for (int i = 0; i < MAX_TYPES; i++) {
+        sm_tree_clear(&bus->by_usage[i]);
+        bus->by_usage[i].cmp = service_usage_cmp;
     }
 
-    ptr = out;
-    for (int i = left; i < lines; i++) {
-        struct logline *ll = &logs[i];
-        char strstamp[32] = {0};
+    bus->usage_sort = sort;
+    if (sort == SORT_NAME)
+        return;
 
-        time_t t = (ll->stamp / 1000000);
-        struct tm *tm = localtime(&t);
-        strftime(strstamp, sizeof(strstamp), "%b %d %H:%M:%S", tm);
+    for (int i = 0; i < all->len; i++)
+        service_usage_link(bus, all->items[i]);
+}
 
-        int written = snprintf(ptr, total - (ptr - out), "%s %s %s[%s]: %s\n",
-                               strstamp, ll->hostname, ll->syslogident, ll->pid, ll->msg);
+/**
+ * Returns the units of the current type whose name or description contain
+ * the search, in list order.
+ *
+ * When the search only grew since the last call, the previous matches are
+ * narrowed down, as nothing else can match. Otherwise, or when units were
+ * added or removed, every unit of the type is matched again.
+ *
+ * @param bus The bus to search.
+ * @return The matching units.
+ */
+static struct service_array * service_search_view(Bus *bus)
+{
+    struct service_array *src = &bus->by_type[display_mode()];
+    struct service_array *a = &bus->by_search;
+    const char *search = display_search();
+    size_t len = strlen(bus->search);
+    int n = 0;
+
+    if (!bus->search_dirty && bus->search_mode == display_mode()) {
+        if (strcmp(bus->search, search) == 0)
+            return a;
+
+        if (strncmp(bus->search, search, len) == 0)
+            src = a;
+    }
 
-        if (written < 0 || written >= total - (ptr - out)) {
-            // Error exception in case of write error or overflow
-            sm_err_set("Failed to write logs");
-            free(out);
-            out = NULL;
-            goto fin;
-        }
+    if (a->cap < src->cap) {
+        Service **items = realloc(a->items, src->cap * sizeof(Service *));
+        if (!items)
+            sm_err_set("Cannot grow search results: %s", strerror(errno));
+        a->items = items;
+        a->cap = src->cap;
+    }
 
-        ptr += written;
+    /* strstr is vectorized by the C library, the keys are lowercased already */
+    for (int i = 0; i < src->len; i++) {
+        if (strstr(src->items[i]->search_key, search))
+            a->items[n++] = src->items[i];
     }
+    a->len = n;
 
-    *ptr = '\0';  // Null termination
+    snprintf(bus->search, sizeof(bus->search), "%s", search);
+    bus->search_mode = display_mode();
+    bus->search_dirty = false;
+    return a;
+}
 
-fin:
-    sd_journal_close(j);
-    return out;
+/* Release a service, dropping it from the lookup indexes of its bus first */
+static void service_free(Bus *bus, Service *svc)
+{
+    if (!svc)
+        return;
+
+    sm_hash_remove(&bus->names, svc->unit);
+    if (svc->object)
+        sm_hash_remove(&bus->objects, svc->object);
+
+    bus_unit_lookup_cancel(bus, svc);
+    bus_operation_cancel(svc);
+    service_mark(bus, svc, false);
+    if (bus->usage_sort != SORT_NAME)
+        service_usage_unlink(bus, svc);
+    display_forget_service(svc);
+    sm_arena_release(&bus->strings, svc->unit);
+    sm_arena_release(&bus->strings, svc->description);
+    sm_arena_release(&bus->strings, svc->search_key);
+    sm_arena_release(&bus->strings, svc->object);
+    if (svc->detail) {
+        free(svc->detail->fragment_path);
+        free(svc->detail->cgroup);
+        free(svc->detail->sysfs_path);
+        free(svc->detail->mount_where);
+        free(svc->detail->mount_what);
+        free(svc->detail->bind_ipv6_only);
+        free(svc->detail);
+    }
+    free(svc->job);
+    free(svc->job_result);
+    sm_pool_free(&bus->records, svc);
+}
+
+/* The manager reports UINT64_MAX for a counter it does not know, shown as 0 */
+static uint64_t service_known(uint64_t value)
+{
+    return value == UINT64_MAX ? 0 : value;
 }
 
 /**
@@ -191,51 +272,54 @@ fin:
  * @return A dynamically allocated string containing the formatted status, or NULL on failure.
  */
 static char * service_format_status(Service *svc) {
+    static const struct service_detail none = {0};
+    const struct service_detail *d = svc->detail ? svc->detail : &none;
     char buf[2048] = {0};
     char *out = NULL;
     char *ptr = buf;
     time_t now = time(NULL);
 
     ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%30s - %s\n", svc->unit, svc->description);
-    ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %s (%s)\n", "Loaded", svc->load, svc->fragment_path);
+    ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %s (%s)\n", "Loaded", svc->load, d->fragment_path);
 
     switch (svc->type) {
         case SERVICE:
             if (strcmp(svc->active, "active") == 0 && strcmp(svc->sub, "running") == 0)
                 ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %s (%s) since %lu seconds ago\n",
-                    "Active", svc->active, svc->sub, now - (svc->exec_main_start / 1000000));
+                    "Active", svc->active, svc->sub, now - (d->exec_main_start / 1000000));
             else
                 ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %s (%s)\n",
                     "Active", svc->active, svc->sub);
+            ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %u\n", "Restarts", d->n_restarts);
 
             if (strcmp(svc->active, "active") == 0) {
-                ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %u\n", "Main PID", svc->main_pid);
+                ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %u\n", "Main PID", d->main_pid);
                 ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %lu (limit: %lu)\n",
-                    "Tasks", svc->tasks_current, svc->tasks_max);
+                    "Tasks", service_known(d->tasks_current), d->tasks_max);
                 ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %.1f (peak: %.1fM swap: %.1fM swap peak: %.1fM zswap: %.1fM))\n",
                     "Memory",
-                    (float)svc->memory_current / 1048576.0,
-                    (float)svc->memory_peak / 1048576.0,
-                    (float)svc->swap_current / 1048576.0,
-                    (float)svc->swap_peak / 1048576.0,
-                    (float)svc->zswap_current / 1048576.0);
-                ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %lums\n", "CPU", svc->cpu_usage / 1000);
-                ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %s\n", "CGroup", svc->cgroup);
+                    (float)service_known(d->memory_current) / 1048576.0,
+                    (float)service_known(d->memory_peak) / 1048576.0,
+                    (float)service_known(d->swap_current) / 1048576.0,
+                    (float)service_known(d->swap_peak) / 1048576.0,
+                    (float)service_known(d->zswap_current) / 1048576.0);
+                ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %lums\n", "CPU", service_known(d->cpu_usage) / 1000);
+                ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %s\n", "CGroup", d->cgroup);
             }
             break;
 
         case DEVICE:
-            ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %s\n", "SysFSPath", svc->sysfs_path);
+            ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %s\n", "SysFSPath", d->sysfs_path);
             break;
 
         case MOUNT:
-            ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %s\n", "Where", svc->mount_where);
-            ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %s\n", "What", svc->mount_what);
+            ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %s\n", "Where", d->mount_where);
+            ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %s\n", "What", d->mount_what);
             break;
 
         case TIMER:
         {
-            time_t next_elapse_sec = svc->next_elapse / 1000000;
+            time_t next_elapse_sec = d->next_elapse / 1000000;
             struct tm *tm_info = localtime(&next_elapse_sec);
             char time_str[26];
             strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
@@ -263,13 +347,13 @@ static char * service_format_status(Service *svc) {
         break;
 
         case SOCKET:
-            ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %s\n", "BindIPv6Only", svc->bind_ipv6_only);
-            if (svc->backlog == INT32_MAX || svc->backlog == UINT32_MAX)
+            ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %s\n", "BindIPv6Only", d->bind_ipv6_only);
+            if (d->backlog == INT32_MAX || d->backlog == UINT32_MAX)
                 ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: Unlimited\n", "Backlog");
-            else if (svc->backlog > INT16_MAX)
-                ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: Invalid value (%u)\n", "Backlog", svc->backlog);
+            else if (d->backlog > INT16_MAX)
+                ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: Invalid value (%u)\n", "Backlog", d->backlog);
             else
-                ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %u\n", "Backlog", svc->backlog);
+                ptr += snprintf(ptr, sizeof(buf) - (ptr - buf), "%11s: %u\n", "Backlog", d->backlog);
             break;
 
         case PATH:
@@ -299,114 +383,203 @@ static char * service_format_status(Service *svc) {
 /**
  * Initializes a new Service struct and returns a pointer to it.
  *
- * This function allocates memory for a new Service struct and returns a pointer to it.
- * The struct is initialized with all fields set to 0 or NULL.
+ * The struct comes from the record pool of the bus and the unit name from
+ * its string arena. All other fields are set to 0 or NULL.
  *
+ * @param bus The bus the unit is listed on.
+ * @param name The unit name.
  * @return A pointer to the newly initialized Service struct.
  */
-Service * service_init(const char *name)
+Service * service_init(Bus *bus, const char *name)
 {
-    Service *svc = NULL;
-    char *nm = NULL;
-
-    svc = calloc(1, sizeof(Service));
-    nm = strdup(name);
-
-    if (!svc || !nm) {
-        free(svc);
-        free(nm);
-        return NULL;
-    }
+    Service *svc = sm_pool_alloc(&bus->records);
 
-    svc->unit = nm;
+    svc->bus = bus;
+    svc->unit = sm_arena_strdup(&bus->strings, name);
     service_set_type(svc);
 
     return svc;
 }
 
+/* The details of a unit for the status window, allocated on first use */
+struct service_detail * service_detail(Service *svc)
+{
+    if (!svc->detail) {
+        svc->detail = calloc(1, sizeof(struct service_detail));
+        if (!svc->detail)
+            sm_err_set("Cannot allocate unit details: %s", strerror(errno));
+    }
+
+    return svc->detail;
+}
+
 /* Return the nth service in the list, accounting for the enabled
  * filter */
 Service * service_nth(Bus *bus, int n)
 {
-    int i = 0;
-    Service *svc;
+    struct service_array *a = &bus->by_type[display_mode()];
 
-    TAILQ_FOREACH(svc, &bus->services, e) {
-        if (display_mode() != ALL && svc->type != display_mode())
-            continue;
+    /* The usage trees follow the shown order, sorted by name they are emptied */
+    service_usage_order(bus, display_sort());
 
-        if (i == n)
-            return svc;
+    if (display_search())
+        a = service_search_view(bus);
+    else if (display_sort() != SORT_NAME)
+        return sm_tree_nth(&bus->by_usage[display_mode()], n);
 
-        i++;
-    }
-    return NULL;
+    if (n < 0 || n >= a->len)
+        return NULL;
+
+    return a->items[n];
 }
 
-/**
- * Finds the service with the specified y-position in the service list.
- *
- * @param ypos The y-position of the service to find.
- * @return The service with the specified y-position, or NULL if not found.
- */
-Service * service_ypos(Bus *bus, int ypos)
+/* Number of services which pass the enabled filter */
+int service_count(Bus *bus)
 {
-    Service *svc;
+    if (display_search())
+        return service_search_view(bus)->len;
 
-    TAILQ_FOREACH(svc, &bus->services, e) {
-        if (svc->ypos == ypos)
-            return svc;
-    }
+    return bus->by_type[display_mode()].len;
+}
+
+/* Return the position the unit with this object path has, or would have,
+ * in the filtered list. Units sorting after a removed unit take its place. */
+int service_rank(Bus *bus, const char *object)
+{
+    if (display_search())
+        return service_array_lower_bound(service_search_view(bus), object);
 
-    return NULL;
+    return service_array_lower_bound(&bus->by_type[display_mode()], object);
 }
 
 /* Insert service into the list in a sorted order */
 void service_insert(Bus *bus, Service *svc)
 {
-    Service *node = NULL;
+    struct service_array *all = &bus->by_type[ALL];
+    int idx;
+
+    svc->bus = bus;
+    service_set_search_key(bus, svc);
+
+    /* The unit name and object path are the index keys, they must not change from here on */
+    sm_hash_put(&bus->names, svc->unit, svc);
+    sm_hash_put(&bus->objects, svc->object, svc);
+
+    if (svc->type != ALL)
+        service_array_insert(&bus->by_type[svc->type], svc);
+
+    /* The list follows the order of the sorted view, so the neighbour is found by rank */
+    idx = service_array_insert(all, svc);
+    if (idx + 1 < all->len)
+        TAILQ_INSERT_BEFORE(all->items[idx + 1], svc, e);
+    else
+        TAILQ_INSERT_TAIL(&bus->services, svc, e);
+
+    if (bus->usage_sort != SORT_NAME)
+        service_usage_link(bus, svc);
+}
+
+/* Copy a new description, the search key has to be built again after it */
+void service_set_description(Bus *bus, Service *svc, const char *description)
+{
+    sm_arena_release(&bus->strings, svc->description);
+    svc->description = sm_arena_strdup(&bus->strings, description);
+}
 
-    bus->total_types[svc->type]++;
-    bus->total_types[ALL]++;
+/* Build the lowercased key the search is matched against, after the description changed */
+void service_set_search_key(Bus *bus, Service *svc)
+{
+    size_t ulen = strlen(svc->unit);
+    size_t dlen = svc->description ? strlen(svc->description) : 0;
+    char *key;
+
+    sm_arena_release(&bus->strings, svc->search_key);
+    key = sm_arena_alloc(&bus->strings, ulen + dlen + 2);
+
+    for (size_t i = 0; i < ulen; i++)
+        key[i] = tolower((unsigned char)svc->unit[i]);
+    key[ulen] = '\n';
+    for (size_t i = 0; i < dlen; i++)
+        key[ulen + 1 + i] = tolower((unsigned char)svc->description[i]);
+    key[ulen + 1 + dlen] = '\0';
+
+    svc->search_key = key;
+    bus->search_dirty = true;
+}
 
-    /* List is empty, add to the head of the list */
-    if (TAILQ_EMPTY(&bus->services)) {
-        TAILQ_INSERT_HEAD(&bus->services, svc, e);
+/* Mark or unmark a unit for an operation on many units, the bus counts its marks */
+void service_mark(Bus *bus, Service *svc, bool marked)
+{
+    if (svc->marked == marked)
         return;
-    }
 
-    /* Find the next entry lexicographically above us and insert */
-    TAILQ_FOREACH(node, &bus->services, e) {
-        if (strcmp(node->object, svc->object) <= 0)
-            continue;
+    svc->marked = marked;
+    bus->n_marked += marked ? 1 : -1;
+}
+
+/* A sampled value of a unit changed, move it to its new place in the usage order */
+void service_usage_changed(Service *svc)
+{
+    Bus *bus = svc->bus;
 
-        TAILQ_INSERT_BEFORE(node, svc, e);
+    if (!bus || bus->usage_sort == SORT_NAME)
+        return;
+
+    if (service_sort_value(svc, bus->usage_sort) == svc->sort_value)
         return;
-    }
 
-    /* This item is the lexicographically greatest, put in tail */
-    TAILQ_INSERT_TAIL(&bus->services, svc, e);
+    service_usage_unlink(bus, svc);
+    service_usage_link(bus, svc);
 }
 
 /* Return the service that matches this unit name */
 Service * service_get_name(Bus *bus, const char *name)
 {
-    Service *svc = NULL;
+    return sm_hash_get(&bus->names, name);
+}
+
+/* Return the service that lives at this object path */
+Service * service_get_object(Bus *bus, const char *object)
+{
+    return sm_hash_get(&bus->objects, object);
+}
+
+/* After a large prune most of the string arena is dead. The strings still in
+ * use are copied into a new one, the indexes are keyed by the copies. */
+static void service_compact(Bus *bus)
+{
+    sm_arena strings = {0};
+    Service *svc;
+
+    sm_hash_clear(&bus->names);
+    sm_hash_clear(&bus->objects);
 
     TAILQ_FOREACH(svc, &bus->services, e) {
-        if (strcmp(name, svc->unit) == 0)
-            return svc;
+        svc->unit = sm_arena_strdup(&strings, svc->unit);
+        svc->object = sm_arena_strdup(&strings, svc->object);
+        if (svc->description)
+            svc->description = sm_arena_strdup(&strings, svc->description);
+        svc->search_key = sm_arena_strdup(&strings, svc->search_key);
+
+        sm_hash_put(&bus->names, svc->unit, svc);
+        sm_hash_put(&bus->objects, svc->object, svc);
     }
-    return NULL;
+
+    sm_arena_free(&bus->strings);
+    bus->strings = strings;
+    sm_pool_trim(&bus->records);
 }
 
 /* Iterate through the list, remove any that haven't been updated since
  * timestamp */
 void services_prune_dead_units(Bus *bus, uint64_t ts)
 {
-    int removed = 0;
     Service *svc = NULL;
 
+    for (int i = 0; i < MAX_TYPES; i++)
+        service_array_prune(&bus->by_type[i], ts);
+    bus->search_dirty = true;
+
     svc = TAILQ_FIRST(&bus->services);
     while (svc) {
       Service *n;
@@ -418,32 +591,16 @@ void services_prune_dead_units(Bus *bus, uint64_t ts)
       }
 
       TAILQ_REMOVE(&bus->services, svc, e);
-      if (svc->ypos > -1)
-          removed++;
-
-      service_free(svc);
+      service_free(bus, svc);
       svc = n;
     }
 
-    /* If and only if we removed a item from our ACTIVE list, clear the screen */
-    if (removed)
-        display_erase();
-    return;
-}
-
-/* This is used during the print services routine
- * to reset the y positions on all services, since not
- * every service is displayed at once. */
-void services_invalidate_ypos(Bus *bus)
-{
-    Service *svc = NULL;
+    if (bus->strings.dead > SM_ARENA_CHUNK && bus->strings.dead * 2 > bus->strings.used)
+        service_compact(bus);
 
-    TAILQ_FOREACH(svc, &bus->services, e) {
-        svc->ypos = -1;
-    }
+    return;
 }
 
-
 /* Fetch the event handlers understanding of the current time */
 uint64_t service_now(void)
 {
@@ -472,29 +629,36 @@ Service * service_next(Service *svc)
     return TAILQ_NEXT(svc, e);
 }
 
-char * service_status_info(Bus *bus, Service *svc)
+/**
+ * Formats the text of the status window of a unit.
+ *
+ * The details must have been fetched with bus_fetch_service_status() before.
+ *
+ * @param svc The service unit to format the status for.
+ * @param logs Log lines to append, or NULL.
+ * @return A dynamically allocated string, or NULL on failure.
+ */
+char * service_status_info(Service *svc, const char *logs)
 {
     char *out = NULL;
-    char *logs = NULL;
-
-    bus_fetch_service_status(bus, svc);
 
     out = service_format_status(svc);
-    logs = service_logs(svc, 10);
-    if (!logs)
-        goto fin;
+    if (!out || !logs)
+        return out;
 
     out = realloc(out, strlen(out) + strlen(logs) + 1);
     if (!out)
-        goto fin;
+        return NULL;
 
     strcat(out, logs);
-
-fin:
-    free(logs);
     return out;
 }
 
+const char * service_string_sort(enum service_sort sort)
+{
+    return service_str_sorts[sort];
+}
+
 const char * service_string_type(enum service_type type)
 {
     return service_str_types[type];
@@ -3,11 +3,16 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <sys/queue.h>
 #include <systemd/sd-bus.h>
+#include "sm_tree.h"
 
 typedef struct service_list service_list;
 
+/* Longest search typed, including the terminator */
+#define SERVICE_SEARCH_MAX 64
+
 enum operation {
     START,
     STOP,
@@ -38,24 +43,26 @@ enum service_type {
     MAX_TYPES
 };
 
-typedef struct Service {
-    int ypos;
-    int changed;
-    uint64_t last_update;
+/* Orders the list can be shown in, by object path or by sampled usage */
+enum service_sort {
+    SORT_NAME,
+    SORT_CPU,
+    SORT_MEMORY,
+    SORT_TASKS,
+    SORT_IO,
+    SORT_RESTARTS,
+    MAX_SORTS
+};
 
-    char *unit;
-    char *load;
-    char *active;
-    char *sub;
-    char *description;
-    char *object;
-    char *fragment_path;
-    char *unit_file_state;
+/* Details only shown in the status window, allocated the first time a
+ * unit is shown there, see service_detail() */
+struct service_detail {
     char invocation_id[33];
-
+    char *fragment_path;
     uint64_t exec_main_start;
     uint32_t main_pid;
-    uint64_t tasks_current;
+    uint32_t n_restarts;
+    uint64_t tasks_current; // As reported by the manager, the list shows the sampled values
     uint64_t tasks_max;
     uint64_t memory_current;
     uint64_t memory_peak;
@@ -64,7 +71,6 @@ typedef struct Service {
     uint64_t zswap_current;
     uint64_t zswap_peak;
     uint64_t cpu_usage;
-
     char *cgroup;
     char *sysfs_path;       // For DEVICE
     char *mount_where;      // For MOUNT
@@ -72,25 +78,87 @@ typedef struct Service {
     uint64_t next_elapse;   // For TIMER
     uint32_t backlog;       // For SOCKET
     char *bind_ipv6_only;   // For SOCKET
+};
 
+typedef struct Service {
+    /* Read for every unit when the list is iterated, searched, ranked,
+     * pruned or sampled. They fill the first cache line of the record. */
+    TAILQ_ENTRY(Service) e;
+    char *search_key;       // Lowercased "unit\ndescription", matched by the search
+    char *object;
+    uint64_t last_update;
+    uint64_t sampled;       // Time of the last usage sample, 0 if there is none, see cgroup.c
     enum service_type type;
-    sd_bus_slot *slot;
+    int changed;
+    bool marked;            // Selected for an operation on many units
 
-    TAILQ_ENTRY(Service) e;
+    /* Read for the rows on screen */
+    char *unit;             // Unit, description, search key and object are in the string arena of the bus
+    char *description;
+    const char *load;       // States are atoms, compared by pointer, see sm_atom()
+    const char *active;
+    const char *sub;
+    const char *unit_file_state;
+    const char *job_type;   // "start", "stop", ... or "job" if another client queued it
+
+    /* Resource usage sampled from the control group */
+    uint64_t cpu_usec;      // cpu.stat usage_usec at the last sample
+    uint64_t io_bytes;      // Bytes read and written at the last sample
+    double cpu_percent;
+    int64_t memory_delta;   // Change of memory_current since the previous sample
+    uint64_t io_rate;       // Bytes per second
+    uint64_t memory_current;
+    uint64_t tasks_current;
+    uint32_t n_restarts;    // For SERVICE, from the status window and PropertiesChanged
+
+    /* Place in the usage order of its bus, in the tree of all units and of its type */
+    uint64_t sort_value;
+    sm_tree_node usage_node[2];
+
+    /* Outstanding asynchronous property lookups, see enum bus_lookup */
+    struct bus_state *bus;
+    bool queued;
+    unsigned lookups;
+    sd_bus_slot *state_slot;
+    TAILQ_ENTRY(Service) q;
+
+    /* The last job queued for the unit, see bus_operation() */
+    char *job;              // Object path of the job while it is pending
+    char *job_result;       // How the last job ended, e.g. "done" or "failed"
+    enum operation op;
+    sd_bus_slot *op_slot;   // Operation waiting for its reply
+    bool op_queued;
+    TAILQ_ENTRY(Service) opq;
+
+    struct service_detail *detail;
 } Service;
 
 TAILQ_HEAD(service_list, Service);
 
+/* Services of one type, kept sorted by object path for ranked access */
+struct service_array {
+    Service **items;
+    int len;
+    int cap;
+};
+
 #include "bus.h"
 Service * service_get_name(Bus *bus, const char *name);
-Service * service_init(const char *name);
+Service * service_get_object(Bus *bus, const char *object);
+Service * service_init(Bus *bus, const char *name);
 Service * service_next(Service *svc);
 Service * service_nth(Bus *bus, int n);
-Service * service_ypos(Bus *bus, int ypos);
-char * service_status_info(Bus *bus, Service *svc);
+struct service_detail * service_detail(Service *svc);
+int service_count(Bus *bus);
+int service_rank(Bus *bus, const char *object);
+char * service_status_info(Service *svc, const char *logs);
+const char * service_string_sort(enum service_sort sort);
 const char * service_string_type(enum service_type type);
 uint64_t service_now(void);
 void service_insert(Bus *bus, Service *svc);
-void services_invalidate_ypos(Bus *bus);
+void service_mark(Bus *bus, Service *svc, bool marked);
+void service_set_description(Bus *bus, Service *svc, const char *description);
+void service_set_search_key(Bus *bus, Service *svc);
+void service_usage_changed(Service *svc);
 void services_prune_dead_units(Bus *bus, uint64_t ts);
 #endif
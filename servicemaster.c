@@ -1,6 +1,81 @@
+#include <getopt.h>
+#include <stdio.h>
 #include "sm_err.h"
 #include "display.h"
 #include "bus.h"
+#include "journal.h"
+#include "cgroup.h"
+#include "dump.h"
+
+/* Set by --dump, the units are written to stdout instead of shown */
+static enum dump_format dump = DUMP_NONE;
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [OPTION]...\n"
+           "  -f, --fps=N           Render at most N frames per second (default %d)\n"
+           "  -l, --lines=N         Keep N log lines in the status window (default %d)\n"
+           "  -d, --dump [FORMAT]   Write the units of both buses to stdout as json (default)\n"
+           "                        or tsv and exit, without using the terminal\n"
+           "  -h, --help            Show this help and exit\n",
+           prog, D_FPS, JOURNAL_LINES);
+}
+
+/* Parse the command line, exits on invalid options */
+static void parse_args(int argc, char **argv)
+{
+    static const struct option options[] = {
+        { "fps",   required_argument, NULL, 'f' },
+        { "lines", required_argument, NULL, 'l' },
+        { "dump",  optional_argument, NULL, 'd' },
+        { "help",  no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    char *end = NULL;
+    long fps, lines;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "f:l:d::h", options, NULL)) != -1) {
+        switch (c) {
+            case 'f':
+                fps = strtol(optarg, &end, 10);
+                if (*end || fps < 1 || fps > 1000)
+                    sm_err_set("Invalid frame rate: %s", optarg);
+                display_set_fps(fps);
+                break;
+
+            case 'l':
+                lines = strtol(optarg, &end, 10);
+                if (*end || lines < 1 || lines > 1000000)
+                    sm_err_set("Invalid number of log lines: %s", optarg);
+                journal_set_lines(lines);
+                break;
+
+            case 'd':
+                /* The format may also follow as a separate argument, -d tsv */
+                if (!optarg && optind < argc && dump_parse_format(argv[optind]) != DUMP_NONE)
+                    optarg = argv[optind++];
+                dump = dump_parse_format(optarg);
+                if (dump == DUMP_NONE)
+                    sm_err_set("Invalid dump format: %s", optarg);
+                break;
+
+            case 'h':
+                usage(argv[0]);
+                exit(EXIT_SUCCESS);
+
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind < argc) {
+        fprintf(stderr, "%s: unexpected argument: %s\n", argv[0], argv[optind]);
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+}
 
 /**
  * Handles user input and performs various operations on systemd services.
@@ -32,8 +107,15 @@ void wait_input()
  * filters them, and then enters a loop to wait for user input.
  * The function returns 0 on successful exit, or -1 on error.
  */
-int main()
+int main(int argc, char **argv)
 {
+    parse_args(argc, argv);
+
+    if (dump != DUMP_NONE) {
+        dump_units(dump);
+        return 0;
+    }
+
     if (geteuid())
         display_set_bus_type(USER);
     else
@@ -41,6 +123,7 @@ int main()
   
     bus_init();
     display_init();
+    cgroup_init();
     display_redraw(bus_currently_displayed());
 
     wait_input();
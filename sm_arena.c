@@ -0,0 +1,75 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sm_err.h"
+#include "sm_arena.h"
+
+/* The newest chunk is first, strings are appended to it */
+struct sm_arena_chunk {
+    struct sm_arena_chunk *next;
+    size_t size;
+    size_t fill;
+    char data[];
+};
+
+/**
+ * Allocates bytes for a string, they stay valid until the arena is freed.
+ *
+ * @param a The arena.
+ * @param size The number of bytes, including the terminating null byte.
+ * @return The bytes, they are not aligned.
+ */
+char * sm_arena_alloc(sm_arena *a, size_t size)
+{
+    struct sm_arena_chunk *c = a->chunks;
+
+    if (!c || c->size - c->fill < size) {
+        size_t csize = size > SM_ARENA_CHUNK / 4 ? size : SM_ARENA_CHUNK - sizeof(*c);
+
+        c = malloc(sizeof(*c) + csize);
+        if (!c)
+            sm_err_set("Cannot grow string arena: %s", strerror(errno));
+        c->size = csize;
+        c->fill = 0;
+
+        /* A large string gets its own chunk, the current one is appended to further */
+        if (csize == size && a->chunks) {
+            c->next = a->chunks->next;
+            a->chunks->next = c;
+        }
+        else {
+            c->next = a->chunks;
+            a->chunks = c;
+        }
+    }
+
+    c->fill += size;
+    a->used += size;
+    return c->data + c->fill - size;
+}
+
+char * sm_arena_strdup(sm_arena *a, const char *str)
+{
+    size_t len = strlen(str) + 1;
+
+    return memcpy(sm_arena_alloc(a, len), str, len);
+}
+
+/* Count a string which is no longer used, its bytes are freed with the arena */
+void sm_arena_release(sm_arena *a, const char *str)
+{
+    if (str)
+        a->dead += strlen(str) + 1;
+}
+
+void sm_arena_free(sm_arena *a)
+{
+    while (a->chunks) {
+        struct sm_arena_chunk *n = a->chunks->next;
+
+        free(a->chunks);
+        a->chunks = n;
+    }
+
+    a->used = 0;
+    a->dead = 0;
+}
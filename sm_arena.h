@@ -0,0 +1,22 @@
+#ifndef _SM_ARENA_H
+#define _SM_ARENA_H
+#include <stddef.h>
+
+#define SM_ARENA_CHUNK 65536
+
+typedef struct sm_arena sm_arena;
+
+/* Strings appended to large chunks and freed all at once. A string released
+ * is only counted, the owner copies the live ones into a new arena once
+ * most of it is dead. */
+struct sm_arena {
+    struct sm_arena_chunk *chunks;
+    size_t used;
+    size_t dead;
+};
+
+char * sm_arena_alloc(sm_arena *a, size_t size);
+char * sm_arena_strdup(sm_arena *a, const char *str);
+void sm_arena_free(sm_arena *a);
+void sm_arena_release(sm_arena *a, const char *str);
+#endif
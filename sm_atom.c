@@ -0,0 +1,23 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sm_err.h"
+#include "sm_hash.h"
+#include "sm_atom.h"
+
+/* Every atom is both key and value of its entry */
+static sm_hash atoms = {0};
+
+const char * sm_atom(const char *str)
+{
+    char *atom = sm_hash_get(&atoms, str);
+
+    if (atom)
+        return atom;
+
+    atom = strdup(str);
+    if (!atom)
+        sm_err_set("Cannot intern %s: %s", str, strerror(errno));
+
+    sm_hash_put(&atoms, atom, atom);
+    return atom;
+}
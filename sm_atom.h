@@ -0,0 +1,8 @@
+#ifndef _SM_ATOM_H
+#define _SM_ATOM_H
+
+/* Interned strings. Equal strings map to the same copy, which lives as long
+ * as the process, so atoms are compared by pointer and never freed. Meant for
+ * values from a small set, like the states of units. */
+const char * sm_atom(const char *str);
+#endif
@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sm_err.h"
+#include "sm_hash.h"
+
+#define SM_HASH_MIN_SIZE 64
+
+/* FNV-1a, never returns 0 so that a zero hash marks an empty slot */
+static uint32_t sm_hash_string(const char *key)
+{
+    uint32_t h = 2166136261u;
+
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+
+    return h ? h : 1;
+}
+
+/* Find the slot which holds key, or the empty slot it would be placed in */
+static struct sm_hash_entry * sm_hash_slot(sm_hash *h, const char *key, uint32_t hash)
+{
+    size_t mask = h->size - 1;
+    size_t i = hash & mask;
+
+    while (h->entries[i].hash) {
+        if (h->entries[i].hash == hash && strcmp(h->entries[i].key, key) == 0)
+            break;
+        i = (i + 1) & mask;
+    }
+
+    return &h->entries[i];
+}
+
+static void sm_hash_resize(sm_hash *h, size_t size)
+{
+    struct sm_hash_entry *old = h->entries;
+    size_t old_size = h->size;
+
+    h->entries = calloc(size, sizeof(struct sm_hash_entry));
+    if (!h->entries)
+        sm_err_set("Cannot grow hash table: %s", strerror(errno));
+    h->size = size;
+
+    for (size_t i = 0; i < old_size; i++) {
+        if (!old[i].hash)
+            continue;
+        *sm_hash_slot(h, old[i].key, old[i].hash) = old[i];
+    }
+
+    free(old);
+}
+
+/**
+ * Looks up the value stored for a key.
+ *
+ * @param h The hash table to search.
+ * @param key The key to look for.
+ * @return The value stored for key, or NULL if there is none.
+ */
+void * sm_hash_get(sm_hash *h, const char *key)
+{
+    if (!h->count)
+        return NULL;
+
+    return sm_hash_slot(h, key, sm_hash_string(key))->value;
+}
+
+/**
+ * Stores a value under a key, replacing any previous value.
+ *
+ * The key is not copied, it must stay valid until it is removed from the table.
+ *
+ * @param h The hash table to insert into.
+ * @param key The key to store the value under.
+ * @param value The value to store.
+ */
+void sm_hash_put(sm_hash *h, const char *key, void *value)
+{
+    uint32_t hash = sm_hash_string(key);
+    struct sm_hash_entry *e;
+
+    /* Keep the load factor below 3/4 */
+    if ((h->count + 1) * 4 >= h->size * 3)
+        sm_hash_resize(h, h->size ? h->size * 2 : SM_HASH_MIN_SIZE);
+
+    e = sm_hash_slot(h, key, hash);
+    if (!e->hash)
+        h->count++;
+
+    e->key = key;
+    e->hash = hash;
+    e->value = value;
+}
+
+/**
+ * Removes a key from the table.
+ *
+ * Entries following the removed one are shifted back, so no tombstones
+ * are left behind and lookups stay short.
+ *
+ * @param h The hash table to remove from.
+ * @param key The key to remove.
+ * @return The value that was stored for key, or NULL if there was none.
+ */
+void * sm_hash_remove(sm_hash *h, const char *key)
+{
+    struct sm_hash_entry *e;
+    size_t mask = h->size - 1;
+    size_t i, j, home;
+    void *value;
+
+    if (!h->count)
+        return NULL;
+
+    e = sm_hash_slot(h, key, sm_hash_string(key));
+    if (!e->hash)
+        return NULL;
+
+    value = e->value;
+    i = e - h->entries;
+    j = i;
+
+    while (true) {
+        j = (j + 1) & mask;
+        if (!h->entries[j].hash)
+            break;
+
+        /* Move the entry back only if its home slot is not between i and j */
+        home = h->entries[j].hash & mask;
+        if ((j > i && (home <= i || home > j)) || (j < i && (home <= i && home > j))) {
+            h->entries[i] = h->entries[j];
+            i = j;
+        }
+    }
+
+    memset(&h->entries[i], 0, sizeof(struct sm_hash_entry));
+    h->count--;
+    return value;
+}
+
+/* Empty the table, keeping its storage for reuse */
+void sm_hash_clear(sm_hash *h)
+{
+    if (h->entries)
+        memset(h->entries, 0, h->size * sizeof(struct sm_hash_entry));
+    h->count = 0;
+}
+
+void sm_hash_free(sm_hash *h)
+{
+    free(h->entries);
+    h->entries = NULL;
+    h->size = 0;
+    h->count = 0;
+}
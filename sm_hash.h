@@ -0,0 +1,27 @@
+#ifndef _SM_HASH_H
+#define _SM_HASH_H
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct sm_hash sm_hash;
+
+/* Keys are not copied, they must outlive their entry in the table */
+struct sm_hash_entry {
+    const char *key;
+    uint32_t hash;
+    void *value;
+};
+
+/* Open addressing string hash table using linear probing */
+struct sm_hash {
+    size_t size;
+    size_t count;
+    struct sm_hash_entry *entries;
+};
+
+void * sm_hash_get(sm_hash *h, const char *key);
+void * sm_hash_remove(sm_hash *h, const char *key);
+void sm_hash_clear(sm_hash *h);
+void sm_hash_free(sm_hash *h);
+void sm_hash_put(sm_hash *h, const char *key, void *value);
+#endif
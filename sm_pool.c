@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "sm_err.h"
+#include "sm_pool.h"
+
+/* The records of a chunk follow its header, the newest chunk is first and
+ * is carved up as records are needed */
+struct sm_pool_chunk {
+    struct sm_pool_chunk *next;
+    size_t live;
+    size_t carved;
+} __attribute__((aligned(64)));
+
+#define SM_POOL_RECORDS(p) ((SM_POOL_CHUNK - sizeof(struct sm_pool_chunk)) / (p)->size)
+
+static struct sm_pool_chunk * sm_pool_chunk(void *rec)
+{
+    return (struct sm_pool_chunk *)((uintptr_t)rec & ~(uintptr_t)(SM_POOL_CHUNK - 1));
+}
+
+/* Map a chunk aligned to its size. Twice the size is mapped and the rest
+ * unmapped again, unlike aligned_alloc() this leaves no holes in the heap. */
+static struct sm_pool_chunk * sm_pool_map(void)
+{
+    char *m = mmap(NULL, 2 * SM_POOL_CHUNK, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    char *c;
+
+    if (m == MAP_FAILED)
+        return NULL;
+
+    c = (char *)(((uintptr_t)m + SM_POOL_CHUNK - 1) & ~(uintptr_t)(SM_POOL_CHUNK - 1));
+    if (c > m)
+        munmap(m, c - m);
+    if (c < m + SM_POOL_CHUNK)
+        munmap(c + SM_POOL_CHUNK, m + SM_POOL_CHUNK - c);
+
+    return (struct sm_pool_chunk *)c;
+}
+
+/**
+ * Prepares an empty pool.
+ *
+ * @param p The pool.
+ * @param size The size of its records, at least a pointer and at most a
+ *        quarter of a chunk.
+ */
+void sm_pool_init(sm_pool *p, size_t size)
+{
+    /* Records larger than a cache line start on one */
+    if (size > 64)
+        size = (size + 63) & ~(size_t)63;
+    else
+        size = (size + 15) & ~(size_t)15;
+
+    p->size = size;
+    p->chunks = NULL;
+    p->free = NULL;
+}
+
+/* Returns a zeroed record */
+void * sm_pool_alloc(sm_pool *p)
+{
+    struct sm_pool_chunk *c = p->chunks;
+    void *rec;
+
+    if (p->free) {
+        rec = p->free;
+        p->free = *(void **)rec;
+        sm_pool_chunk(rec)->live++;
+        return memset(rec, 0, p->size);
+    }
+
+    if (!c || c->carved == SM_POOL_RECORDS(p)) {
+        c = sm_pool_map();
+        if (!c)
+            sm_err_set("Cannot grow record pool: %s", strerror(errno));
+        c->next = p->chunks;
+        c->live = 0;
+        c->carved = 0;
+        p->chunks = c;
+    }
+
+    rec = (char *)(c + 1) + c->carved++ * p->size;
+    c->live++;
+    return memset(rec, 0, p->size);
+}
+
+/* Returns a record to the pool, the next allocation reuses it */
+void sm_pool_free(sm_pool *p, void *rec)
+{
+    if (!rec)
+        return;
+
+    sm_pool_chunk(rec)->live--;
+    *(void **)rec = p->free;
+    p->free = rec;
+}
+
+/* Releases the chunks none of whose records are in use */
+void sm_pool_trim(sm_pool *p)
+{
+    struct sm_pool_chunk **c = &p->chunks;
+    void **rec = &p->free;
+
+    /* Drop the records of empty chunks from the free list first */
+    while (*rec) {
+        if (sm_pool_chunk(*rec)->live)
+            rec = (void **)*rec;
+        else
+            *rec = **(void ***)rec;
+    }
+
+    while (*c) {
+        struct sm_pool_chunk *n = (*c)->next;
+
+        if ((*c)->live) {
+            c = &(*c)->next;
+            continue;
+        }
+
+        munmap(*c, SM_POOL_CHUNK);
+        *c = n;
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef _SM_POOL_H
+#define _SM_POOL_H
+#include <stddef.h>
+
+/* Chunks are aligned to their size, so a record finds its chunk by its address */
+#define SM_POOL_CHUNK 65536
+
+typedef struct sm_pool sm_pool;
+
+/* Records of one size carved from large chunks. Freed records are reused
+ * before the pool grows, chunks left without records are released by
+ * sm_pool_trim(). */
+struct sm_pool {
+    size_t size;
+    struct sm_pool_chunk *chunks;
+    void *free;
+};
+
+void * sm_pool_alloc(sm_pool *p);
+void sm_pool_free(sm_pool *p, void *rec);
+void sm_pool_init(sm_pool *p, size_t size);
+void sm_pool_trim(sm_pool *p);
+#endif
@@ -0,0 +1,189 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "sm_stats.h"
+
+static struct sm_stats stats = {0};
+
+/* Bucket of a latency. Below 4 usec each value has its own bucket, above
+ * that each power of two is split in four by the next two bits. */
+static int sm_stats_bucket(uint64_t usec)
+{
+    int octave, bucket;
+
+    if (usec < SM_STATS_SUB)
+        return usec;
+
+    octave = 63 - __builtin_clzll(usec);
+    bucket = (octave - 1) * SM_STATS_SUB + ((usec >> (octave - 2)) & (SM_STATS_SUB - 1));
+
+    return bucket < SM_STATS_BUCKETS ? bucket : SM_STATS_BUCKETS - 1;
+}
+
+/* The smallest latency above every latency in a bucket */
+static uint64_t sm_stats_bucket_limit(int bucket)
+{
+    int octave = bucket / SM_STATS_SUB + 1;
+
+    if (bucket < SM_STATS_SUB)
+        return bucket + 1;
+
+    return (uint64_t)(SM_STATS_SUB + 1 + bucket % SM_STATS_SUB) << (octave - 2);
+}
+
+static int sm_stats_decade(uint64_t usec)
+{
+    int decade = 0;
+
+    for (uint64_t limit = 10; usec >= limit && decade < SM_STATS_DECADES - 1; limit *= 10)
+        decade++;
+
+    return decade;
+}
+
+const struct sm_stats * sm_stats_get(void)
+{
+    return &stats;
+}
+
+/* The monotonic clock in usec. Latencies are taken with it, the time of the
+ * event loop is cached for the whole iteration it is read in. */
+uint64_t sm_stats_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LLU + ts.tv_nsec / 1000;
+}
+
+/**
+ * Estimates a percentile of a histogram.
+ *
+ * @param h The histogram.
+ * @param p The percentile, e.g. 0.99.
+ * @return The limit of the bucket the percentile falls into, it is at most
+ *         25% above the exact value. 0 if nothing was recorded.
+ */
+uint64_t sm_stats_percentile(const sm_stats_hist *h, double p)
+{
+    uint64_t rank = (uint64_t)(p * h->count + 0.5);
+    uint64_t seen = 0;
+
+    if (!h->count)
+        return 0;
+    if (rank < 1)
+        rank = 1;
+
+    for (int i = 0; i < SM_STATS_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint64_t limit = sm_stats_bucket_limit(i);
+            return limit < h->max ? limit : h->max;
+        }
+    }
+
+    return h->max;
+}
+
+/* Record how long something took, in usec */
+void sm_stats_latency(enum sm_stats_latency which, uint64_t usec)
+{
+    sm_stats_hist *h = &stats.latency[which];
+
+    h->count++;
+    h->total += usec;
+    if (usec > h->max)
+        h->max = usec;
+    h->buckets[sm_stats_bucket(usec)]++;
+    h->decades[sm_stats_decade(usec)]++;
+}
+
+/* Count a D-Bus call, method is usually a literal so its pointer is compared first */
+void sm_stats_call(const char *method)
+{
+    int i;
+
+    for (i = 0; i < stats.n_methods; i++) {
+        if (stats.methods[i].method == method || strcmp(stats.methods[i].method, method) == 0) {
+            stats.methods[i].count++;
+            return;
+        }
+    }
+
+    if (stats.n_methods == SM_STATS_METHODS)
+        return;
+
+    stats.methods[i].method = method;
+    stats.methods[i].count = 1;
+    stats.n_methods++;
+}
+
+/* Count a signal received, and whether there was a listed unit it applied to */
+void sm_stats_signal(bool handled)
+{
+    stats.signals++;
+    if (!handled)
+        stats.dropped++;
+}
+
+/* Count bytes sent to the terminal */
+void sm_stats_tty(uint64_t bytes)
+{
+    stats.tty_bytes += bytes;
+}
+
+/**
+ * Returns the bytes the process wrote so far, from wchar in /proc/self/io.
+ * The difference around a terminal update is what it sent to the terminal.
+ *
+ * @return The bytes written, or 0 if procfs is not available.
+ */
+uint64_t sm_stats_written(void)
+{
+    static int fd = -2;
+    char buf[256];
+    char *wchar;
+    ssize_t len;
+
+    if (fd == -2)
+        fd = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+
+    len = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0)
+        return 0;
+    buf[len] = '\0';
+
+    wchar = strstr(buf, "wchar: ");
+    return wchar ? strtoull(wchar + 7, NULL, 10) : 0;
+}
+
+/* Take the rates since the last tick and the resident set size */
+void sm_stats_tick(uint64_t now)
+{
+    double elapsed = (now - stats.ticked) / 1000000.0;
+    unsigned long pages = 0;
+    FILE *statm;
+
+    if (stats.ticked && elapsed > 0) {
+        for (int i = 0; i < stats.n_methods; i++)
+            stats.methods[i].rate = (stats.methods[i].count - stats.methods[i].last) / elapsed;
+        stats.tty_rate = (stats.tty_bytes - stats.tty_last) / elapsed;
+    }
+
+    for (int i = 0; i < stats.n_methods; i++)
+        stats.methods[i].last = stats.methods[i].count;
+    stats.tty_last = stats.tty_bytes;
+    stats.ticked = now;
+
+    statm = fopen("/proc/self/statm", "r");
+    if (statm) {
+        if (fscanf(statm, "%*u %lu", &pages) == 1)
+            stats.rss = (uint64_t)pages * sysconf(_SC_PAGESIZE);
+        fclose(statm);
+    }
+}
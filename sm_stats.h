@@ -0,0 +1,63 @@
+#ifndef _SM_STATS_H
+#define _SM_STATS_H
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Latencies are kept in log-linear buckets, four per power of two up to 2^24 usec */
+#define SM_STATS_SUB 4
+#define SM_STATS_BUCKETS (24 * SM_STATS_SUB)
+
+/* Decades of the latency histograms, <10us up to >=1s */
+#define SM_STATS_DECADES 7
+
+/* Distinct D-Bus methods counted, calls of any further ones are not */
+#define SM_STATS_METHODS 24
+
+/* What latencies are recorded for */
+enum sm_stats_latency {
+    STATS_FRAME,        // display_redraw()
+    STATS_STATUS,       // GetAll round trip of the status window
+    STATS_JOURNAL,      // Reading new journal entries of the followed unit
+    STATS_MAX_LATENCY
+};
+
+typedef struct sm_stats_hist {
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint64_t buckets[SM_STATS_BUCKETS];
+    uint64_t decades[SM_STATS_DECADES];
+} sm_stats_hist;
+
+/* D-Bus calls issued for one method, the rate is taken at the last tick */
+struct sm_stats_method {
+    const char *method;
+    uint64_t count;
+    uint64_t last;
+    double rate;
+};
+
+/* Counters since startup, rates and RSS are updated by sm_stats_tick() */
+struct sm_stats {
+    sm_stats_hist latency[STATS_MAX_LATENCY];
+    struct sm_stats_method methods[SM_STATS_METHODS];
+    int n_methods;
+    uint64_t signals;
+    uint64_t dropped;       // Signals for units which are not listed
+    uint64_t tty_bytes;
+    uint64_t tty_last;
+    double tty_rate;
+    uint64_t rss;
+    uint64_t ticked;
+};
+
+const struct sm_stats * sm_stats_get(void);
+uint64_t sm_stats_now(void);
+uint64_t sm_stats_percentile(const sm_stats_hist *h, double p);
+uint64_t sm_stats_written(void);
+void sm_stats_call(const char *method);
+void sm_stats_latency(enum sm_stats_latency which, uint64_t usec);
+void sm_stats_signal(bool handled);
+void sm_stats_tick(uint64_t now);
+void sm_stats_tty(uint64_t bytes);
+#endif
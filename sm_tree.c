@@ -0,0 +1,209 @@
+#include <stdlib.h>
+#include "sm_tree.h"
+
+/* xorshift32, the priorities only need to be spread, not unpredictable */
+static uint32_t sm_tree_random(void)
+{
+    static uint32_t state = 2463534242u;
+
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static int sm_tree_size(sm_tree_node *n)
+{
+    return n ? n->size : 0;
+}
+
+static void sm_tree_update(sm_tree_node *n)
+{
+    n->size = 1 + sm_tree_size(n->left) + sm_tree_size(n->right);
+}
+
+/* Split a subtree into the nodes ordered before value and the others */
+static void sm_tree_split(sm_tree *t, sm_tree_node *n, const void *value, sm_tree_node **l, sm_tree_node **r)
+{
+    if (!n) {
+        *l = NULL;
+        *r = NULL;
+        return;
+    }
+
+    if (t->cmp(n->value, value) < 0) {
+        sm_tree_split(t, n->right, value, &n->right, r);
+        *l = n;
+    }
+    else {
+        sm_tree_split(t, n->left, value, l, &n->left);
+        *r = n;
+    }
+
+    sm_tree_update(n);
+}
+
+/* Join two subtrees, every node of l is ordered before every node of r */
+static sm_tree_node * sm_tree_merge(sm_tree_node *l, sm_tree_node *r)
+{
+    if (!l)
+        return r;
+    if (!r)
+        return l;
+
+    if (l->priority > r->priority) {
+        l->right = sm_tree_merge(l->right, r);
+        sm_tree_update(l);
+        return l;
+    }
+
+    r->left = sm_tree_merge(l, r->left);
+    sm_tree_update(r);
+    return r;
+}
+
+static sm_tree_node * sm_tree_insert_at(sm_tree *t, sm_tree_node *n, sm_tree_node *node)
+{
+    if (!n)
+        return node;
+
+    /* The new node belongs above this one, it takes the subtree apart */
+    if (node->priority > n->priority) {
+        sm_tree_split(t, n, node->value, &node->left, &node->right);
+        sm_tree_update(node);
+        return node;
+    }
+
+    if (t->cmp(node->value, n->value) < 0)
+        n->left = sm_tree_insert_at(t, n->left, node);
+    else
+        n->right = sm_tree_insert_at(t, n->right, node);
+
+    sm_tree_update(n);
+    return n;
+}
+
+static sm_tree_node * sm_tree_remove_at(sm_tree *t, sm_tree_node *n, const void *value)
+{
+    sm_tree_node *m;
+    int c;
+
+    if (!n)
+        return NULL;
+
+    c = t->cmp(value, n->value);
+    if (c == 0) {
+        m = sm_tree_merge(n->left, n->right);
+        n->left = NULL;
+        n->right = NULL;
+        return m;
+    }
+
+    if (c < 0)
+        n->left = sm_tree_remove_at(t, n->left, value);
+    else
+        n->right = sm_tree_remove_at(t, n->right, value);
+
+    sm_tree_update(n);
+    return n;
+}
+
+/* Number of values in the tree */
+int sm_tree_count(sm_tree *t)
+{
+    return sm_tree_size(t->root);
+}
+
+/**
+ * Finds the position of a value in the order of the tree.
+ *
+ * @param t The tree to search.
+ * @param value The value to look for.
+ * @return The number of values ordered before value, which is its position
+ *         if it is in the tree and the position it would take otherwise.
+ */
+int sm_tree_rank(sm_tree *t, const void *value)
+{
+    sm_tree_node *n = t->root;
+    int rank = 0;
+    int c;
+
+    while (n) {
+        c = t->cmp(value, n->value);
+        if (c == 0)
+            return rank + sm_tree_size(n->left);
+
+        if (c < 0)
+            n = n->left;
+        else {
+            rank += sm_tree_size(n->left) + 1;
+            n = n->right;
+        }
+    }
+
+    return rank;
+}
+
+/**
+ * Returns the value at a position in the order of the tree.
+ *
+ * @param t The tree to search.
+ * @param n The position, starting at 0.
+ * @return The value, or NULL if n is out of range.
+ */
+void * sm_tree_nth(sm_tree *t, int n)
+{
+    sm_tree_node *node = t->root;
+    int left;
+
+    if (n < 0 || n >= sm_tree_count(t))
+        return NULL;
+
+    while (node) {
+        left = sm_tree_size(node->left);
+        if (n == left)
+            return node->value;
+
+        if (n < left)
+            node = node->left;
+        else {
+            n -= left + 1;
+            node = node->right;
+        }
+    }
+
+    return NULL;
+}
+
+/* Empty the tree. The nodes belong to their records, they are not freed. */
+void sm_tree_clear(sm_tree *t)
+{
+    t->root = NULL;
+}
+
+/**
+ * Adds a value to the tree.
+ *
+ * The value must not be in the tree already, and the fields its order
+ * depends on must not change until it is removed again.
+ *
+ * @param t The tree to insert into.
+ * @param node The node to link into the tree, usually embedded in value.
+ * @param value The value to insert.
+ */
+void sm_tree_insert(sm_tree *t, sm_tree_node *node, void *value)
+{
+    node->left = NULL;
+    node->right = NULL;
+    node->priority = sm_tree_random();
+    node->size = 1;
+    node->value = value;
+
+    t->root = sm_tree_insert_at(t, t->root, node);
+}
+
+/* Remove a value from the tree, it is found by its order */
+void sm_tree_remove(sm_tree *t, const void *value)
+{
+    t->root = sm_tree_remove_at(t, t->root, value);
+}
@@ -0,0 +1,32 @@
+#ifndef _SM_TREE_H
+#define _SM_TREE_H
+#include <stdint.h>
+
+typedef struct sm_tree sm_tree;
+typedef struct sm_tree_node sm_tree_node;
+
+/* Orders two values, it must not return 0 for two different values */
+typedef int (*sm_tree_cmp)(const void *a, const void *b);
+
+/* Nodes are embedded in the record they order, value points back to it */
+struct sm_tree_node {
+    sm_tree_node *left;
+    sm_tree_node *right;
+    uint32_t priority;
+    int size;
+    void *value;
+};
+
+/* Order statistic tree, a treap whose nodes count the nodes below them */
+struct sm_tree {
+    sm_tree_node *root;
+    sm_tree_cmp cmp;
+};
+
+int sm_tree_count(sm_tree *t);
+int sm_tree_rank(sm_tree *t, const void *value);
+void * sm_tree_nth(sm_tree *t, int n);
+void sm_tree_clear(sm_tree *t);
+void sm_tree_insert(sm_tree *t, sm_tree_node *node, void *value);
+void sm_tree_remove(sm_tree *t, const void *value);
+#endif